@@ -3,33 +3,106 @@
 #include "Camera/PlayerCameraManager.h"
 #include "Components/TextBlock.h"
 #include "Components/WidgetComponent.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "Engine/Font.h"
+#include "Engine/LocalPlayer.h"
 #include "Engine/World.h"
+#include "GameFramework/HUD.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneManagement.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "ProceduralMeshComponent.h"
+#include "Misc/Paths.h"
 #include "QuadTree/QuadTreeNode.h"
 
 AQuadTreeTerrain::AQuadTreeTerrain()
 {
     PrimaryActorTick.bCanEverTick = true;
     RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+    TerrainMesh = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("TerrainMesh"));
+    TerrainMesh->SetupAttachment(RootComponent);
+    TerrainMesh->bUseAsyncCooking = true;
 }
 
 void AQuadTreeTerrain::BeginPlay()
 {
     Super::BeginPlay();     // 调用该父类的BeginPlay函数
+    ClearQuadTree();
+    if (UsesWidgetLabels())
+    {
+        WarmWidgetPool();
+    }
+    else
+    {
+        EmptyWidgetPool();
+    }
+    if (LabelMode == ETerrainLabelMode::Batched)
+    {
+        HUDPostRenderHandle = AHUD::OnHUDPostRender.AddUObject(this, &AQuadTreeTerrain::DrawLabels);
+    }
+    if (bGenerateMesh && bStreamHeightTiles)
+    {
+        OpenHeightTiles();
+    }
     BuildQuadTree();
 }
 
+void AQuadTreeTerrain::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    AHUD::OnHUDPostRender.Remove(HUDPostRenderHandle);
+    TileStreamer.Close();
+    Super::EndPlay(EndPlayReason);
+}
+
 void AQuadTreeTerrain::Tick(float DeltaTime)
 {
     Super::Tick(DeltaTime);
     
-    if (RootNode.IsValid())
+    if (RootNode)
     {
-        const FVector CameraLocation = GetCameraLocation();
-        SubdivideNode(RootNode, CameraLocation);
+        // 视图每帧只收集一次，遍历中所有节点共用
+        UpdateLodViews();
+        if (ShouldUpdateLod())
+        {
+            bInLodWalk = true;
+            if (bParallelLod)
+            {
+                EvaluateLodParallel();
+            }
+            else
+            {
+                SubdivideNode(*RootNode);
+            }
+            bInLodWalk = false;
+        }
+        if (bTimeSliceLod)
+        {
+            DrainLodQueue();
+        }
+        
+        if (bGenerateMesh)
+        {
+            // 有高度块加载完成，用到它的叶子需要重建网格块
+            // 等待子块的细分也可以继续了，下次完整评估
+            if (TileStreamer.IsOpen() && TileStreamer.Pump() > 0)
+            {
+                bTopologyChanged = true;
+                bLodStale = true;
+            }
+            if (bTopologyChanged)
+            {
+                BalanceTree();
+                UpdatePatches();
+                bTopologyChanged = false;
+            }
+            PollPatchJobs();
+        }
         
         if (bDrawDebug)
         {
-            DrawDebugQuadTree(RootNode);
+            DrawDebugQuadTree(*RootNode);
         }
     }
 }
@@ -43,240 +116,1112 @@ void AQuadTreeTerrain::OnConstruction(const FTransform& Transform)
 
 void AQuadTreeTerrain::BuildQuadTree()
 {
-    // 创建根节点
-    RootNode = MakeShared<QuadTreeNode>(
-        FVector2D(GetActorLocation().X, GetActorLocation().Y), 
-        TerrainSize, 
-        0
-    );
+    // 只建各层的页表和细分位（10 层共约 0.35 MB），节点页在细分时分配，编辑属性重建时不再分配整棵树
+    // 与属性上限一致：完全细分到 10 层时节点共 128 MB
+    MaxDepth = FMath::Clamp(MaxDepth, 1, 10);
+    NodePages.SetNum(MaxDepth + 1);
+    SubdividedBits.SetNum(MaxDepth + 1);
+    for (int32 Depth = 0; Depth <= MaxDepth; Depth++)
+    {
+        const int32 Side = 1 << Depth;
+        const int32 PagesPerSide = Side / GetPageSide(Depth);
+        NodePages[Depth].SetNum(PagesPerSide * PagesPerSide);
+        SubdividedBits[Depth].Init(false, Side * Side);
+    }
+    NodePages[0][0] = MakeUnique<QuadTreeNode[]>(1);
+    RootNode = &NodePages[0][0][0];
+    RootNode->Center = FVector2D(GetActorLocation().X, GetActorLocation().Y);
+    RootNode->Size = TerrainSize;
     
     // 创建根节点Widget
-    CreateOrUpdateWidget(RootNode);
+    CreateOrUpdateWidget(*RootNode);
+    bTopologyChanged = true;
+    bLodStale = true;
 }
 
-void AQuadTreeTerrain::SubdivideNode(TSharedPtr<QuadTreeNode> Node, const FVector& CameraLocation)
+void AQuadTreeTerrain::SubdivideNode(QuadTreeNode& Node)
 {
-    if (!Node.IsValid()) return;
+    // 所有视图离上次评估的位置都足够近，子树内没有节点会越过距离带
+    if (bLodIncrementalPass && LodOdometer - Node.LodEvalOdometer < Node.LodSlack) return;
     
     // 检查是否需要细分
-    if (!Node->IsSubdivided && ShouldSubdivide(*Node, CameraLocation) && Node->Depth < MaxDepth)
+    if (!IsSubdivided(Node) && ShouldSubdivide(Node) && Node.Depth < MaxDepth)
     {
-        // 计算子节点尺寸
-        const FVector2D ChildSize = Node->Size * 0.5f;
-        const FVector2D HalfChildSize = ChildSize * 0.5f;
-        
-        // 创建四个子节点
-        // 西北 (North-West)
-        Node->NW = MakeShared<QuadTreeNode>(
-            FVector2D(Node->Center.X - HalfChildSize.X, Node->Center.Y + HalfChildSize.Y),
-            ChildSize,
-            Node->Depth + 1
-        );
-        
-        // 东北 (North-East)
-        Node->NE = MakeShared<QuadTreeNode>(
-            FVector2D(Node->Center.X + HalfChildSize.X, Node->Center.Y + HalfChildSize.Y),
-            ChildSize,
-            Node->Depth + 1
-        );
-        
-        // 西南 (South-West)
-        Node->SW = MakeShared<QuadTreeNode>(
-            FVector2D(Node->Center.X - HalfChildSize.X, Node->Center.Y - HalfChildSize.Y),
-            ChildSize,
-            Node->Depth + 1
-        );
-        
-        // 东南 (South-East)
-        Node->SE = MakeShared<QuadTreeNode>(
-            FVector2D(Node->Center.X + HalfChildSize.X, Node->Center.Y - HalfChildSize.Y),
-            ChildSize,
-            Node->Depth + 1
-        );
+        if (bTimeSliceLod)
+        {
+            QueueLodOp(Node, true);
+        }
+        else if (AreChildTilesResident(Node))
+        {
+            SplitNode(Node);
+        }
+        else
+        {
+            // 子块还在加载，下次必须重新检查
+            Node.LodEvalOdometer = LodOdometer;
+            Node.LodSlack = 0.f;
+            return;
+        }
+    }
+    
+    // 递归处理子节点
+    if (IsSubdivided(Node))
+    {
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            SubdivideNode(GetChild(Node, Quadrant));
+        }
         
-        // 标记节点已细分
-        Node->IsSubdivided = true;
+        // 检查是否所有子节点都应该合并
+        const bool bAllChildrenShouldMerge = ShouldMergeChildren(Node);
+        const bool bMergeBlocked = bAllChildrenShouldMerge && bGenerateMesh && !CanMerge(Node);
+        if (bAllChildrenShouldMerge && !bMergeBlocked)
+        {
+            if (bTimeSliceLod)
+            {
+                QueueLodOp(Node, false);
+            }
+            else
+            {
+                MergeNodes(Node);
+            }
+        }
         
-        // 移除父节点Widget
-        if (Node->WidgetComponent)
+        // 被2:1平衡挡住的合并取决于邻居，每次都要重新检查
+        if (bMergeBlocked)
+        {
+            Node.LodEvalOdometer = LodOdometer;
+            Node.LodSlack = 0.f;
+            return;
+        }
+    }
+    
+    // 子树的余量取自身与各子节点余量（扣除子节点评估后视图已移动的距离）的最小值
+    Node.LodEvalOdometer = LodOdometer;
+    Node.LodSlack = GetLodSlack(Node);
+    if (IsSubdivided(Node))
+    {
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            const QuadTreeNode& Child = GetChild(Node, Quadrant);
+            Node.LodSlack = FMath::Min(Node.LodSlack, Child.LodSlack - static_cast<float>(LodOdometer - Child.LodEvalOdometer));
+        }
+    }
+    Node.LodSlack = FMath::Max(Node.LodSlack, 0.f);
+}
+
+void AQuadTreeTerrain::EvaluateLodParallel()
+{
+    // 上层节点串行展开，ParallelLodDepth处（或更浅的叶子）的子树作为并行任务
+    TArray<QuadTreeNode*> Frontier;
+    TArray<QuadTreeNode*> Upper;
+    CollectLodFrontier(*RootNode, Frontier, Upper);
+    
+    TArray<TArray<FLodOp>> SubtreeCommands;
+    SubtreeCommands.SetNum(Frontier.Num());
+    ParallelFor(Frontier.Num(), [this, &Frontier, &SubtreeCommands](int32 Index)
+    {
+        EvaluateLod(*Frontier[Index], SubtreeCommands[Index]);
+    });
+    
+    // 上层节点的合并判定需要子节点的余量，逆前序即可保证子节点先于父节点
+    TArray<FLodOp> Commands;
+    for (int32 i = Upper.Num() - 1; i >= 0; i--)
+    {
+        EvaluateLodMerge(*Upper[i], Commands);
+    }
+    
+    // 先执行较粗的合并，被合并掉的子树里的命令在执行时作废
+    for (TArray<FLodOp>& Subtree : SubtreeCommands)
+    {
+        Commands.Append(MoveTemp(Subtree));
+    }
+    ApplyLodCommands(Commands);
+}
+
+void AQuadTreeTerrain::CollectLodFrontier(QuadTreeNode& Node, TArray<QuadTreeNode*>& OutFrontier, TArray<QuadTreeNode*>& OutUpper)
+{
+    if (bLodIncrementalPass && LodOdometer - Node.LodEvalOdometer < Node.LodSlack) return;
+    
+    if (Node.Depth >= ParallelLodDepth || !IsSubdivided(Node))
+    {
+        OutFrontier.Add(&Node);
+        return;
+    }
+    OutUpper.Add(&Node);
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        CollectLodFrontier(GetChild(Node, Quadrant), OutFrontier, OutUpper);
+    }
+}
+
+void AQuadTreeTerrain::EvaluateLod(QuadTreeNode& Node, TArray<FLodOp>& OutCommands)
+{
+    // 在工作线程执行：只读细分位和视图，只写本子树节点的LOD字段
+    if (bLodIncrementalPass && LodOdometer - Node.LodEvalOdometer < Node.LodSlack) return;
+    
+    if (!IsSubdivided(Node))
+    {
+        Node.LodEvalOdometer = LodOdometer;
+        if (Node.Depth < MaxDepth && ShouldSubdivide(Node))
         {
-            Node->WidgetComponent->DestroyComponent();
-            Node->WidgetComponent = nullptr;
+            FLodOp& Command = OutCommands.AddDefaulted_GetRef();
+            Command.Node = &Node;
+            Command.bSplit = true;
+            Command.Priority = bTimeSliceLod ? GetLodPriority(Node, true) : 0.f;
+            Node.LodSlack = 0.f; // 细分后的子节点下次必须评估
+            return;
         }
+        Node.LodSlack = FMath::Max(GetLodSlack(Node), 0.f);
+        return;
+    }
+    
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        EvaluateLod(GetChild(Node, Quadrant), OutCommands);
+    }
+    EvaluateLodMerge(Node, OutCommands);
+}
+
+void AQuadTreeTerrain::EvaluateLodMerge(QuadTreeNode& Node, TArray<FLodOp>& OutCommands)
+{
+    Node.LodEvalOdometer = LodOdometer;
+    if (ShouldMergeChildren(Node))
+    {
+        // 被2:1平衡挡住的合并同样每次重新检查
+        if (!bGenerateMesh || CanMerge(Node))
+        {
+            FLodOp& Command = OutCommands.AddDefaulted_GetRef();
+            Command.Node = &Node;
+            Command.bSplit = false;
+            Command.Priority = bTimeSliceLod ? GetLodPriority(Node, false) : 0.f;
+        }
+        Node.LodSlack = 0.f;
+        return;
+    }
+    
+    Node.LodSlack = GetLodSlack(Node);
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        const QuadTreeNode& Child = GetChild(Node, Quadrant);
+        Node.LodSlack = FMath::Min(Node.LodSlack, Child.LodSlack - static_cast<float>(LodOdometer - Child.LodEvalOdometer));
+    }
+    Node.LodSlack = FMath::Max(Node.LodSlack, 0.f);
+}
+
+void AQuadTreeTerrain::ApplyLodCommands(const TArray<FLodOp>& Commands)
+{
+    // 每个叶子每次最多细分一级，新的子节点还没评估过；有改动时下一帧完整评估，相机不动也能收敛
+    bool bApplied = false;
+    for (const FLodOp& Command : Commands)
+    {
+        QuadTreeNode& Node = *Command.Node;
+        if (!IsNodeActive(Node)) continue;
         
-        // 为子节点创建Widget
-        CreateOrUpdateWidget(Node->NW);
-        CreateOrUpdateWidget(Node->NE);
-        CreateOrUpdateWidget(Node->SW);
-        CreateOrUpdateWidget(Node->SE);
+        if (bTimeSliceLod)
+        {
+            // 优先级已在判定阶段算好
+            if (!Node.bLodQueued)
+            {
+                LodQueue.HeapPush(Command);
+                Node.bLodQueued = true;
+            }
+        }
+        else if (Command.bSplit)
+        {
+            // 子块未就绪的细分丢弃，子块加载完成后的完整评估会再次提出
+            if (AreChildTilesResident(Node))
+            {
+                SplitNode(Node);
+                bApplied = true;
+            }
+        }
+        else if (IsSubdivided(Node) && (!bGenerateMesh || CanMerge(Node)))
+        {
+            // 同一批中的其他命令可能改变了邻居，重新检查2:1平衡
+            MergeNodes(Node);
+            bApplied = true;
+        }
     }
+    if (bApplied)
+    {
+        bLodStale = true;
+    }
+}
+
+bool AQuadTreeTerrain::ShouldMergeChildren(const QuadTreeNode& Node) const
+{
+    bool bAllChildrenShouldMerge = true;
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        bAllChildrenShouldMerge &= ShouldMerge(GetChild(Node, Quadrant));
+    }
+    return bAllChildrenShouldMerge;
+}
+
+void AQuadTreeTerrain::QueueLodOp(QuadTreeNode& Node, bool bSplit)
+{
+    if (Node.bLodQueued) return;
     
-    // 递归处理子节点
-    if (Node->IsSubdivided)
+    FLodOp Op;
+    Op.Node = &Node;
+    Op.bSplit = bSplit;
+    Op.Priority = GetLodPriority(Node, bSplit);
+    LodQueue.HeapPush(Op);
+    Node.bLodQueued = true;
+}
+
+void AQuadTreeTerrain::DrainLodQueue()
+{
+    const double StartTime = FPlatformTime::Seconds();
+    int32 Ops = 0;
+    while (LodQueue.Num() > 0)
     {
-        SubdivideNode(Node->NW, CameraLocation);
-        SubdivideNode(Node->NE, CameraLocation);
-        SubdivideNode(Node->SW, CameraLocation);
-        SubdivideNode(Node->SE, CameraLocation);
+        if (MaxLodOpsPerFrame > 0 && Ops >= MaxLodOpsPerFrame) break;
+        if (LodTimeBudgetMs > 0.f && Ops > 0 && (FPlatformTime::Seconds() - StartTime) * 1000.0 >= LodTimeBudgetMs) break;
         
-        // 检查是否所有子节点都应该合并
-        bool bAllChildrenShouldMerge = true;
-        bAllChildrenShouldMerge &= ShouldMerge(*Node->NW, CameraLocation);
-        bAllChildrenShouldMerge &= ShouldMerge(*Node->NE, CameraLocation);
-        bAllChildrenShouldMerge &= ShouldMerge(*Node->SW, CameraLocation);
-        bAllChildrenShouldMerge &= ShouldMerge(*Node->SE, CameraLocation);
+        FLodOp Op;
+        LodQueue.HeapPop(Op, false);
+        QuadTreeNode& Node = *Op.Node;
+        Node.bLodQueued = false;
+        if (!IsNodeActive(Node)) continue; // 所在子树已被合并
         
-        if (bAllChildrenShouldMerge)
+        // 入队后摄像机可能已经移动，执行前重新检查
+        if (Op.bSplit)
+        {
+            if (!IsSubdivided(Node) && Node.Depth < MaxDepth && ShouldSubdivide(Node) && AreChildTilesResident(Node))
+            {
+                SplitNode(Node);
+                Ops++;
+            }
+        }
+        else if (IsSubdivided(Node) && ShouldMergeChildren(Node) && (!bGenerateMesh || CanMerge(Node)))
+        {
+            MergeNodes(Node);
+            Ops++;
+        }
+    }
+}
+
+float AQuadTreeTerrain::GetLodPriority(const QuadTreeNode& Node, bool bSplit) const
+{
+    // 分裂：节点误差 / 阈值，即 距离带半径 / 距离；合并：反过来，子节点越远越急
+    // 多个视图时分裂取最急的视图，合并取最不急的视图（所有视图都同意才合并）
+    float Priority = bSplit ? 0.f : MAX_flt;
+    for (const FLodView& View : LodViews)
+    {
+        const float Distance = FMath::Max(GetLodDistance(Node, View), 1.f);
+        const float BandScale = GetBandScale(View);
+        if (bSplit && SplitBands.IsValidIndex(Node.Depth))
         {
-            MergeNodes(Node, CameraLocation);
+            Priority = FMath::Max(Priority, SplitBands[Node.Depth] * BandScale / Distance);
+        }
+        else if (!bSplit && MergeBands.IsValidIndex(Node.Depth + 1))
+        {
+            Priority = FMath::Min(Priority, Distance / FMath::Max(MergeBands[Node.Depth + 1] * BandScale, 1.f));
         }
     }
+    return Priority == MAX_flt ? 0.f : Priority;
 }
 
-void AQuadTreeTerrain::MergeNodes(TSharedPtr<QuadTreeNode> Node, const FVector& CameraLocation)
+void AQuadTreeTerrain::SplitNode(QuadTreeNode& Node)
 {
-    if (!Node.IsValid() || !Node->IsSubdivided) return;
+    if (IsSubdivided(Node) || Node.Depth >= MaxDepth) return;
+    
+    // 子节点所在页第一次用到时分配，之后细分只需置位；重置上次激活时留下的LOD状态
+    AllocateChildren(Node);
+    SetSubdivided(Node, true);
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        QuadTreeNode& Child = GetChild(Node, Quadrant);
+        Child.LodSlack = 0.f;
+        Child.PatchTileLevel = INDEX_NONE;
+    }
+    if (!bInLodWalk)
+    {
+        bLodStale = true;
+    }
+    
+    // 回收父节点Widget
+    ReleaseWidget(Node.WidgetComponent);
+    Node.WidgetComponent = nullptr;
     
-    // 递归合并子节点的子节点
-    MergeNodes(Node->NW, CameraLocation);
-    MergeNodes(Node->NE, CameraLocation);
-    MergeNodes(Node->SW, CameraLocation);
-    MergeNodes(Node->SE, CameraLocation);
+    // 为子节点创建Widget
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        CreateOrUpdateWidget(GetChild(Node, Quadrant));
+    }
+    bTopologyChanged = true;
+}
+
+void AQuadTreeTerrain::AllocateChildren(const QuadTreeNode& Node)
+{
+    // 页边长是偶数，四个子节点 (2X, 2Y) ~ (2X+1, 2Y+1) 总在同一页
+    const int32 Depth = Node.Depth + 1;
+    const int32 ChildX = Node.X * 2;
+    const int32 ChildY = Node.Y * 2;
+    TUniquePtr<QuadTreeNode[]>& Page = NodePages[Depth][GetPageIndex(Depth, ChildX, ChildY)];
+    if (Page) return;
     
-    // 删除所有子节点及其Widget
-    RemoveNodeAndWidget(Node->NW);
-    RemoveNodeAndWidget(Node->NE);
-    RemoveNodeAndWidget(Node->SW);
-    RemoveNodeAndWidget(Node->SE);
+    // 以根节点为原点，和已分配的节点保持一致
+    const int32 PageSide = GetPageSide(Depth);
+    const int32 BaseX = ChildX & ~(PageSide - 1);
+    const int32 BaseY = ChildY & ~(PageSide - 1);
+    const FVector2D Origin = RootNode->Center - RootNode->Size * 0.5f;
+    const FVector2D NodeSize = RootNode->Size / (1 << Depth);
+    Page = MakeUnique<QuadTreeNode[]>(PageSide * PageSide);
+    for (int32 Y = 0; Y < PageSide; Y++)
+    {
+        for (int32 X = 0; X < PageSide; X++)
+        {
+            QuadTreeNode& Child = Page[Y * PageSide + X];
+            Child.Depth = Depth;
+            Child.X = BaseX + X;
+            Child.Y = BaseY + Y;
+            Child.Center = Origin + FVector2D((Child.X + 0.5f) * NodeSize.X, (Child.Y + 0.5f) * NodeSize.Y);
+            Child.Size = NodeSize;
+        }
+    }
+}
+
+void AQuadTreeTerrain::MergeNodes(QuadTreeNode& Node)
+{
+    if (!IsSubdivided(Node)) return;
     
-    // 重置子节点指针
-    Node->NW.Reset();
-    Node->NE.Reset();
-    Node->SW.Reset();
-    Node->SE.Reset();
+    // 删除所有子节点及其Widget，子树的细分位一并清除
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        RemoveNodeAndWidget(GetChild(Node, Quadrant));
+    }
     
     // 标记节点未细分
-    Node->IsSubdivided = false;
+    SetSubdivided(Node, false);
+    bTopologyChanged = true;
+    if (!bInLodWalk)
+    {
+        bLodStale = true;
+    }
     
     // 为当前节点创建Widget
     CreateOrUpdateWidget(Node);
 }
 
-void AQuadTreeTerrain::CreateOrUpdateWidget(TSharedPtr<QuadTreeNode> Node)
+void AQuadTreeTerrain::CreateOrUpdateWidget(QuadTreeNode& Node)
 {
-    if (!Node.IsValid() || !WidgetClass) return;
+    if (!UsesWidgetLabels()) return;
     
-    // 如果Widget不存在，创建新的
-    if (!Node->WidgetComponent)
+    // 如果Widget不存在，从池中取一个
+    if (!Node.WidgetComponent)
     {
-        Node->WidgetComponent = NewObject<UWidgetComponent>(this);
-        Node->WidgetComponent->RegisterComponent();
-        Node->WidgetComponent->SetWidgetClass(WidgetClass);
-        Node->WidgetComponent->SetDrawSize(WidgetSize);
-        Node->WidgetComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+        Node.WidgetComponent = AcquireWidget();
         
         // 设置Widget位置为节点中心
-        const FVector WidgetLocation(Node->Center.X, Node->Center.Y, WidgetHeight);
-        Node->WidgetComponent->SetWorldLocation(WidgetLocation);
-        
-        // 设置Widget始终面向摄像机
-        Node->WidgetComponent->SetWidgetSpace(EWidgetSpace::Screen);
+        const FVector WidgetLocation(Node.Center.X, Node.Center.Y, WidgetHeight);
+        Node.WidgetComponent->SetWorldLocation(WidgetLocation);
     }
     
     // 更新Widget缩放比例（基于深度）
-    const float Scale = 1.0f / FMath::Pow(2.0f, Node->Depth);
-    Node->WidgetComponent->SetWorldScale3D(FVector(Scale));
+    const float Scale = 1.0f / FMath::Pow(2.0f, Node.Depth);
+    Node.WidgetComponent->SetWorldScale3D(FVector(Scale));
     
     // 如果Widget已存在，直接更新内容
-    if (UUserWidget* UserWidget = Cast<UUserWidget>(Node->WidgetComponent->GetUserWidgetObject()))
+    if (UUserWidget* UserWidget = Cast<UUserWidget>(Node.WidgetComponent->GetUserWidgetObject()))
     {
         if (UTextBlock* TextBlock = Cast<UTextBlock>(UserWidget->GetWidgetFromName(TEXT("TextBlock_120"))))
         {
-            TextBlock->SetText(FText::FromString(FString::FromInt(Node->Depth)));
+            TextBlock->SetText(FText::FromString(FString::FromInt(Node.Depth)));
         }
     }
 }
 
-void AQuadTreeTerrain::RemoveNodeAndWidget(TSharedPtr<QuadTreeNode> Node)
+void AQuadTreeTerrain::RemoveNodeAndWidget(QuadTreeNode& Node)
 {
-    if (!Node.IsValid()) return;
-    
     // 递归删除子节点
-    if (Node->IsSubdivided)
+    if (IsSubdivided(Node))
     {
-        RemoveNodeAndWidget(Node->NW);
-        RemoveNodeAndWidget(Node->NE);
-        RemoveNodeAndWidget(Node->SW);
-        RemoveNodeAndWidget(Node->SE);
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            RemoveNodeAndWidget(GetChild(Node, Quadrant));
+        }
+        SetSubdivided(Node, false);
     }
     
-    // 删除Widget组件
-    if (Node->WidgetComponent)
-    {
-        Node->WidgetComponent->DestroyComponent();
-        Node->WidgetComponent = nullptr;
-    }
+    // 回收Widget组件
+    ReleaseWidget(Node.WidgetComponent);
+    Node.WidgetComponent = nullptr;
+    
+    // 节点存储会被复用，进行中的网格任务作废
+    ReleaseMeshSection(Node.MeshSection);
+    Node.MeshSection = INDEX_NONE;
+    Node.bPatchPending = false;
+    Node.PatchSerial++;
 }
 
-void AQuadTreeTerrain::DrawDebugQuadTree(TSharedPtr<QuadTreeNode> Node)
+void AQuadTreeTerrain::DrawDebugQuadTree(const QuadTreeNode& Node)
 {
-    if (!Node.IsValid() || !GetWorld()) return;
+    if (!GetWorld()) return;
     
     // 绘制当前节点边界
-    const FVector Center3D(Node->Center.X, Node->Center.Y, 0.f);
-    const FVector Extent(Node->Size.X * 0.5f, Node->Size.Y * 0.5f, 10.f);
+    const FVector Center3D(Node.Center.X, Node.Center.Y, 0.f);
+    const FVector Extent(Node.Size.X * 0.5f, Node.Size.Y * 0.5f, 10.f);
     
     // 根据深度调整颜色
-    const float DepthRatio = static_cast<float>(Node->Depth) / MaxDepth;
+    const float DepthRatio = static_cast<float>(Node.Depth) / MaxDepth;
     const FColor Color = FColor::MakeRedToGreenColorFromScalar(1.0f - DepthRatio);
     
     DrawDebugBox(GetWorld(), Center3D, Extent, FQuat::Identity, Color, false, -1.f, 0, 2.f);
     
     // 递归绘制子节点
-    if (Node->IsSubdivided)
+    if (IsSubdivided(Node))
     {
-        DrawDebugQuadTree(Node->NW);
-        DrawDebugQuadTree(Node->NE);
-        DrawDebugQuadTree(Node->SW);
-        DrawDebugQuadTree(Node->SE);
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            DrawDebugQuadTree(GetChild(Node, Quadrant));
+        }
     }
 }
 
-FVector AQuadTreeTerrain::GetCameraLocation() const
+void AQuadTreeTerrain::UpdateLodViews()
 {
-    APlayerCameraManager* CameraManager = UGameplayStatics::GetPlayerCameraManager(this, 0);
-    if (CameraManager)
+    LodViews.Reset();
+    UWorld* World = GetWorld();
+    if (!World) return;
+    
+    // 分屏时每个本地玩家一个视图，视口宽度按各自占的比例计算
+    float ViewportWidth = 0.f;
+    for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+    {
+        APlayerController* PlayerController = It->Get();
+        if (!PlayerController || !PlayerController->IsLocalController() || !PlayerController->PlayerCameraManager) continue;
+        
+        int32 ViewportX = 0, ViewportY = 0;
+        PlayerController->GetViewportSize(ViewportX, ViewportY);
+        FVector2D ViewSize(ViewportX, ViewportY);
+        if (const ULocalPlayer* LocalPlayer = PlayerController->GetLocalPlayer())
+        {
+            ViewSize *= LocalPlayer->Size;
+        }
+        
+        FLodView& LodView = LodViews.AddDefaulted_GetRef();
+        const FMinimalViewInfo& CameraView = PlayerController->PlayerCameraManager->GetCameraCacheView();
+        LodView.Location = CameraView.Location;
+        LodView.Rotation = CameraView.Rotation;
+        if (ViewSize.X >= 1.f && ViewSize.Y >= 1.f)
+        {
+            FMinimalViewInfo View = CameraView;
+            View.AspectRatio = ViewSize.X / ViewSize.Y;
+            View.bConstrainAspectRatio = true;
+            
+            FMatrix ViewMatrix, ProjectionMatrix, ViewProjectionMatrix;
+            UGameplayStatics::GetViewProjectionMatrix(View, ViewMatrix, ProjectionMatrix, ViewProjectionMatrix);
+            GetViewFrustumBounds(LodView.Frustum, ViewProjectionMatrix, false);
+            LodView.bHasFrustum = true;
+            
+            // FOV为水平视角
+            LodView.ProjectionScale = ViewSize.X / (2.f * FMath::Tan(FMath::DegreesToRadians(View.FOV) * 0.5f));
+            ViewportWidth = FMath::Max(ViewportWidth, static_cast<float>(ViewSize.X));
+        }
+    }
+    
+    // 额外视点（观战摄像机等）不裁剪，屏幕空间误差按 90 度视角和最宽的玩家视口估算
+    for (const AActor* Viewer : AdditionalViewers)
     {
-        return CameraManager->GetCameraLocation();
+        if (!IsValid(Viewer)) continue;
+        FLodView& LodView = LodViews.AddDefaulted_GetRef();
+        LodView.Location = Viewer->GetActorLocation();
+        LodView.Rotation = Viewer->GetActorRotation();
+        LodView.ProjectionScale = (ViewportWidth > 0.f ? ViewportWidth : 1920.f) * 0.5f;
     }
-    return FVector::ZeroVector;
 }
 
-float AQuadTreeTerrain::GetDistanceToCamera(const FVector2D& NodeCenter) const
+float AQuadTreeTerrain::GetDistanceToCamera(const FVector2D& NodeCenter, const FVector& CameraLocation) const
 {
-    const FVector CameraLocation = GetCameraLocation();
     // 四叉树主要用于分割平面，z坐标没有意义
     const FVector NodeCenter3D(NodeCenter.X, NodeCenter.Y, 0.f);
     return FVector::Dist(CameraLocation, NodeCenter3D);
 }
 
-bool AQuadTreeTerrain::ShouldSubdivide(const QuadTreeNode& Node, const FVector& CameraLocation) const
+bool AQuadTreeTerrain::ShouldUpdateLod()
+{
+    bLodIncrementalPass = false;
+    UpdateLodBands();
+    if (!bIncrementalLod) return true;
+    
+    // 视图增减时完整评估；屏幕空间误差模式下视锥和误差带还随视角、视口变化
+    bool bViewChanged = LodViews.Num() != LastLodViews.Num();
+    float MaxMove = 0.f;
+    for (int32 i = 0; i < LodViews.Num() && !bViewChanged; i++)
+    {
+        const FLodView& View = LodViews[i];
+        const FLodView& Last = LastLodViews[i];
+        if (LodMetric == ETerrainLodMetric::ScreenSpaceError)
+        {
+            bViewChanged = View.bHasFrustum != Last.bHasFrustum
+                || !View.Rotation.Equals(Last.Rotation, LodRotationThreshold)
+                || !FMath::IsNearlyEqual(View.ProjectionScale, Last.ProjectionScale, Last.ProjectionScale * 0.01f);
+        }
+        MaxMove = FMath::Max(MaxMove, FVector::Dist(View.Location, Last.Location));
+    }
+    
+    const bool bFullPass = bLodStale || bViewChanged;
+    if (!bFullPass && MaxMove < LodMoveThreshold) return false;
+    
+    // 里程只增不减：任一视图相对节点评估时的位移都不超过里程差
+    LodOdometer += MaxMove;
+    bLodIncrementalPass = !bFullPass;
+    bLodStale = false;
+    LastLodViews = LodViews;
+    return true;
+}
+
+void AQuadTreeTerrain::UpdateLodBands()
+{
+    SplitBands.SetNumUninitialized(MaxDepth + 1);
+    MergeBands.SetNumUninitialized(MaxDepth + 1);
+    for (int32 Depth = 0; Depth <= MaxDepth; Depth++)
+    {
+        if (LodMetric == ETerrainLodMetric::ScreenSpaceError)
+        {
+            // 误差 = 几何误差 * ProjectionScale / 距离，反解出误差等于阈值时的距离（不含ProjectionScale，由GetBandScale补上）
+            const float GeometricError = FMath::Max(TerrainSize.X, TerrainSize.Y) / FMath::Pow(2.0f, Depth) * GeometricErrorFactor;
+            SplitBands[Depth] = GeometricError / PixelTolerance;
+            MergeBands[Depth] = 2.f * GeometricError / FMath::Max(PixelTolerance * MergeHysteresis, KINDA_SMALL_NUMBER);
+        }
+        else
+        {
+            SplitBands[Depth] = SubdivideDistanceFactor / FMath::Pow(2.0f, Depth);
+            MergeBands[Depth] = MergeDistanceFactor / FMath::Pow(2.0f, Depth - 1);
+        }
+    }
+}
+
+float AQuadTreeTerrain::GetBandScale(const FLodView& View) const
+{
+    return LodMetric == ETerrainLodMetric::ScreenSpaceError ? View.ProjectionScale : 1.f;
+}
+
+float AQuadTreeTerrain::GetLodDistance(const QuadTreeNode& Node, const FLodView& View) const
+{
+    if (LodMetric == ETerrainLodMetric::ScreenSpaceError)
+    {
+        return FMath::Sqrt(GetNodeBounds(Node.Center, Node.Size).ComputeSquaredDistanceToPoint(View.Location));
+    }
+    return GetDistanceToCamera(Node.Center, View.Location);
+}
+
+float AQuadTreeTerrain::GetLodSlack(const QuadTreeNode& Node) const
+{
+    // 任一视图的判定翻转之前，“任一视图需要细分 / 所有视图都可合并”的结果都不变
+    float Slack = MAX_flt;
+    for (const FLodView& View : LodViews)
+    {
+        const float Distance = GetLodDistance(Node, View);
+        const float BandScale = GetBandScale(View);
+        if (!IsSubdivided(Node) && Node.Depth < MaxDepth)
+        {
+            Slack = FMath::Min(Slack, FMath::Abs(Distance - SplitBands[Node.Depth] * BandScale));
+        }
+        if (Node.Depth > 0)
+        {
+            Slack = FMath::Min(Slack, FMath::Abs(Distance - MergeBands[Node.Depth] * BandScale));
+        }
+        if (LodMetric == ETerrainLodMetric::ScreenSpaceError && bFrustumCull && View.bHasFrustum)
+        {
+            Slack = FMath::Min(Slack, GetFrustumSlack(GetNodeBounds(Node.Center, Node.Size), View));
+        }
+    }
+    return Slack;
+}
+
+float AQuadTreeTerrain::GetFrustumSlack(const FBox& Bounds, const FLodView& View) const
+{
+    // 与FConvexVolume::IntersectBox相同的判定：任一平面上包围盒完全在外侧即不相交
+    // 摄像机平移d时各平面最多移动d，余量为离翻转最近的平面距离
+    const FVector Center = Bounds.GetCenter();
+    const FVector Extent = Bounds.GetExtent();
+    float MaxOutside = -MAX_flt;
+    float MinInside = MAX_flt;
+    for (const FPlane& Plane : View.Frustum.Planes)
+    {
+        const float PushOut = FMath::Abs(Extent.X * Plane.X) + FMath::Abs(Extent.Y * Plane.Y) + FMath::Abs(Extent.Z * Plane.Z);
+        const float Margin = Plane.PlaneDot(Center) - PushOut;
+        MaxOutside = FMath::Max(MaxOutside, Margin);
+        MinInside = FMath::Min(MinInside, -Margin);
+    }
+    return MaxOutside > 0.f ? MaxOutside : MinInside;
+}
+
+FBox AQuadTreeTerrain::GetNodeBounds(const FVector2D& Center, const FVector2D& Size) const
+{
+    const FVector2D HalfSize = Size * 0.5f;
+    return FBox(FVector(Center.X - HalfSize.X, Center.Y - HalfSize.Y, 0.f),
+        FVector(Center.X + HalfSize.X, Center.Y + HalfSize.Y, NodeBoundsHeight));
+}
+
+float AQuadTreeTerrain::GetScreenSpaceError(const QuadTreeNode& Node, const FVector2D& Size, const FLodView& View) const
+{
+    // 使用包围盒上离摄像机最近的点，摄像机在节点上方时误差最大
+    const float Distance = FMath::Max(GetLodDistance(Node, View), 1.f);
+    const float GeometricError = FMath::Max(Size.X, Size.Y) * GeometricErrorFactor;
+    return GeometricError * View.ProjectionScale / Distance;
+}
+
+bool AQuadTreeTerrain::IsNodeVisible(const QuadTreeNode& Node, const FLodView& View) const
+{
+    if (!bFrustumCull || !View.bHasFrustum) return true;
+    const FBox Bounds = GetNodeBounds(Node.Center, Node.Size);
+    return View.Frustum.IntersectBox(Bounds.GetCenter(), Bounds.GetExtent());
+}
+
+bool AQuadTreeTerrain::ShouldSubdivide(const QuadTreeNode& Node) const
 {
-    const float Distance = GetDistanceToCamera(Node.Center);
-    return Distance < (SubdivideDistanceFactor / FMath::Pow(2.0f, Node.Depth));
+    // 任一视图需要即细分
+    for (const FLodView& View : LodViews)
+    {
+        if (LodMetric == ETerrainLodMetric::ScreenSpaceError)
+        {
+            if (IsNodeVisible(Node, View) && GetScreenSpaceError(Node, Node.Size, View) > PixelTolerance) return true;
+        }
+        else if (GetDistanceToCamera(Node.Center, View.Location) < (SubdivideDistanceFactor / FMath::Pow(2.0f, Node.Depth)))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
-bool AQuadTreeTerrain::ShouldMerge(const QuadTreeNode& Node, const FVector& CameraLocation) const
+bool AQuadTreeTerrain::ShouldMerge(const QuadTreeNode& Node) const
 {
-    const float Distance = GetDistanceToCamera(Node.Center);
-    return Distance > (MergeDistanceFactor / FMath::Pow(2.0f, Node.Depth - 1));
+    // 所有视图都允许才合并；没有视图时保持现状
+    if (LodViews.Num() == 0) return false;
+    for (const FLodView& View : LodViews)
+    {
+        if (LodMetric == ETerrainLodMetric::ScreenSpaceError)
+        {
+            // 与距离判定一致：按父节点（尺寸加倍）的误差判断
+            if (IsNodeVisible(Node, View) && GetScreenSpaceError(Node, Node.Size * 2.f, View) >= PixelTolerance * MergeHysteresis) return false;
+        }
+        else if (GetDistanceToCamera(Node.Center, View.Location) <= (MergeDistanceFactor / FMath::Pow(2.0f, Node.Depth - 1)))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 void AQuadTreeTerrain::ClearQuadTree()
 {
-    if (RootNode.IsValid())
+    if (RootNode)
+    {
+        RemoveNodeAndWidget(*RootNode);
+        RootNode = nullptr;
+    }
+    NodePages.Reset();
+    SubdividedBits.Reset();
+    LodQueue.Reset();
+    ClearTerrainMesh();
+}
+
+void AQuadTreeTerrain::DrawLabels(AHUD* HUD, UCanvas* Canvas)
+{
+    if (!RootNode || !Canvas || HUD->GetWorld() != GetWorld()) return;
+    
+    UFont* Font = LabelFont ? LabelFont : GEngine->GetSmallFont();
+    FCanvasTextItem TextItem(FVector2D::ZeroVector, FText::GetEmpty(), Font, LabelColor);
+    TextItem.Scale = FVector2D(LabelScale);
+    TextItem.bCentreX = true;
+    TextItem.bCentreY = true;
+    
+    // 所有标签使用同一字体，画布会把它们合并到同一批次
+    TArray<const QuadTreeNode*, TInlineAllocator<64>> Stack;
+    Stack.Add(RootNode);
+    while (Stack.Num() > 0)
+    {
+        const QuadTreeNode* Node = Stack.Pop(false);
+        if (IsSubdivided(*Node))
+        {
+            for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+            {
+                Stack.Add(&GetChild(*Node, Quadrant));
+            }
+            continue;
+        }
+        const FVector Projected = Canvas->Project(FVector(Node->Center.X, Node->Center.Y, WidgetHeight));
+        if (Projected.Z <= 0.f) continue; // 在摄像机后方
+        if (Projected.X < 0.f || Projected.Y < 0.f || Projected.X > Canvas->ClipX || Projected.Y > Canvas->ClipY) continue;
+        
+        TextItem.Position = FVector2D(Projected.X, Projected.Y);
+        TextItem.Text = FText::AsNumber(Node->Depth);
+        Canvas->DrawItem(TextItem);
+    }
+}
+
+UWidgetComponent* AQuadTreeTerrain::AcquireWidget()
+{
+    if (WidgetPool.Num() > 0)
+    {
+        UWidgetComponent* Widget = WidgetPool.Pop(false);
+        Widget->SetVisibility(true);
+        Widget->SetComponentTickEnabled(true);
+        return Widget;
+    }
+    
+    // 池已空，创建新的
+    return CreatePooledWidget();
+}
+
+UWidgetComponent* AQuadTreeTerrain::CreatePooledWidget()
+{
+    UWidgetComponent* Widget = NewObject<UWidgetComponent>(this);
+    Widget->RegisterComponent();
+    Widget->SetWidgetClass(WidgetClass);
+    Widget->SetDrawSize(WidgetSize);
+    Widget->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    
+    // 设置Widget始终面向摄像机
+    Widget->SetWidgetSpace(EWidgetSpace::Screen);
+    return Widget;
+}
+
+void AQuadTreeTerrain::ReleaseWidget(UWidgetComponent* Widget)
+{
+    if (!Widget) return;
+    
+    // 超过上限时直接销毁，避免一次大范围合并后长期占用
+    if (WidgetPool.Num() >= WidgetPoolMaxSize || Widget->GetWidgetClass() != WidgetClass)
+    {
+        Widget->DestroyComponent();
+        return;
+    }
+    Widget->SetVisibility(false);
+    Widget->SetComponentTickEnabled(false);
+    WidgetPool.Add(Widget);
+}
+
+void AQuadTreeTerrain::WarmWidgetPool()
+{
+    if (!WidgetClass) return;
+    
+    const int32 WarmCount = FMath::Min(WidgetPoolWarmSize, WidgetPoolMaxSize);
+    while (WidgetPool.Num() < WarmCount)
+    {
+        UWidgetComponent* Widget = CreatePooledWidget();
+        Widget->InitWidget(); // 预先创建UserWidget，避免首次使用时构建
+        ReleaseWidget(Widget);
+    }
+}
+
+void AQuadTreeTerrain::EmptyWidgetPool()
+{
+    for (UWidgetComponent* Widget : WidgetPool)
+    {
+        if (Widget)
+        {
+            Widget->DestroyComponent();
+        }
+    }
+    WidgetPool.Empty();
+}
+AQuadTreeTerrain::QuadTreeNode* AQuadTreeTerrain::FindLeaf(const FVector2D& Point)
+{
+    return FindNode(Point, MAX_int32);
+}
+
+AQuadTreeTerrain::QuadTreeNode* AQuadTreeTerrain::FindNode(const FVector2D& Point, int32 MaxNodeDepth)
+{
+    if (!RootNode) return nullptr;
+    
+    const FVector2D HalfSize = RootNode->Size * 0.5f;
+    if (FMath::Abs(Point.X - RootNode->Center.X) > HalfSize.X || FMath::Abs(Point.Y - RootNode->Center.Y) > HalfSize.Y)
+    {
+        return nullptr;
+    }
+    
+    QuadTreeNode* Node = RootNode;
+    while (IsSubdivided(*Node) && Node->Depth < MaxNodeDepth)
+    {
+        const bool bEast = Point.X >= Node->Center.X;
+        const bool bNorth = Point.Y >= Node->Center.Y;
+        Node = &GetChild(*Node, bNorth ? (bEast ? Child_NE : Child_NW) : (bEast ? Child_SE : Child_SW));
+    }
+    return Node;
+}
+
+FVector2D AQuadTreeTerrain::GetEdgeProbe(const QuadTreeNode& Node, uint8 Edge) const
+{
+    // 向外偏移最小节点尺寸的四分之一，保证落在邻居内部
+    const FVector2D HalfSize = Node.Size * 0.5f;
+    const FVector2D Offset = HalfSize + TerrainSize / FMath::Pow(2.0f, MaxDepth) * 0.25f;
+    switch (Edge)
     {
-        RemoveNodeAndWidget(RootNode);
-        RootNode.Reset();
+    case TerrainEdge_West:  return FVector2D(Node.Center.X - Offset.X, Node.Center.Y);
+    case TerrainEdge_East:  return FVector2D(Node.Center.X + Offset.X, Node.Center.Y);
+    case TerrainEdge_South: return FVector2D(Node.Center.X, Node.Center.Y - Offset.Y);
+    default:                return FVector2D(Node.Center.X, Node.Center.Y + Offset.Y);
     }
-}
\ No newline at end of file
+}
+
+void AQuadTreeTerrain::BalanceTree()
+{
+    if (!RootNode) return;
+    
+    // 从根节点沿细分位收集叶子，只访问当前树中的节点
+    TArray<QuadTreeNode*> Queue;
+    TArray<QuadTreeNode*, TInlineAllocator<64>> Stack;
+    Stack.Add(RootNode);
+    while (Stack.Num() > 0)
+    {
+        QuadTreeNode* Node = Stack.Pop(false);
+        if (!IsSubdivided(*Node))
+        {
+            Queue.Add(Node);
+            continue;
+        }
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            Stack.Add(&GetChild(*Node, Quadrant));
+        }
+    }
+    
+    // 邻居比本叶子粗两级以上时细分邻居；新产生的叶子也需要检查
+    while (Queue.Num() > 0)
+    {
+        QuadTreeNode* Leaf = Queue.Pop(false);
+        if (IsSubdivided(*Leaf)) continue;
+        
+        for (uint8 Edge : { TerrainEdge_West, TerrainEdge_East, TerrainEdge_South, TerrainEdge_North })
+        {
+            QuadTreeNode* Neighbor = FindLeaf(GetEdgeProbe(*Leaf, Edge));
+            if (Neighbor && Neighbor->Depth < Leaf->Depth - 1)
+            {
+                SplitNode(*Neighbor);
+                for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+                {
+                    Queue.Add(&GetChild(*Neighbor, Quadrant));
+                }
+            }
+        }
+    }
+}
+
+bool AQuadTreeTerrain::CanMerge(const QuadTreeNode& Node) const
+{
+    // 合并后Node成为深度为D的叶子，同深度的邻居靠近Node一侧的子节点不能再细分
+    const int32 Side = 1 << Node.Depth;
+    for (uint8 Edge : { TerrainEdge_West, TerrainEdge_East, TerrainEdge_South, TerrainEdge_North })
+    {
+        // 同层邻居直接由网格坐标得到
+        const int32 NX = Node.X + (Edge == TerrainEdge_West ? -1 : Edge == TerrainEdge_East ? 1 : 0);
+        const int32 NY = Node.Y + (Edge == TerrainEdge_South ? -1 : Edge == TerrainEdge_North ? 1 : 0);
+        if (NX < 0 || NY < 0 || NX >= Side || NY >= Side) continue;
+        
+        // 所在页未分配的邻居从未激活过
+        const QuadTreeNode* Neighbor = FindLevelNode(Node.Depth, NX, NY);
+        if (!Neighbor || !IsNodeActive(*Neighbor) || !IsSubdivided(*Neighbor)) continue;
+        
+        int32 Facing[2];
+        switch (Edge)
+        {
+        case TerrainEdge_West:  Facing[0] = Child_NE; Facing[1] = Child_SE; break;
+        case TerrainEdge_East:  Facing[0] = Child_NW; Facing[1] = Child_SW; break;
+        case TerrainEdge_South: Facing[0] = Child_NW; Facing[1] = Child_NE; break;
+        default:                Facing[0] = Child_SW; Facing[1] = Child_SE; break;
+        }
+        if (IsSubdivided(GetChild(*Neighbor, Facing[0])) || IsSubdivided(GetChild(*Neighbor, Facing[1]))) return false;
+    }
+    return true;
+}
+
+uint8 AQuadTreeTerrain::ComputeStitchMask(const QuadTreeNode& Node)
+{
+    uint8 Mask = 0;
+    for (uint8 Edge : { TerrainEdge_West, TerrainEdge_East, TerrainEdge_South, TerrainEdge_North })
+    {
+        const QuadTreeNode* Neighbor = FindLeaf(GetEdgeProbe(Node, Edge));
+        if (Neighbor && Neighbor->Depth < Node.Depth)
+        {
+            Mask |= Edge;
+        }
+    }
+    return Mask;
+}
+
+void AQuadTreeTerrain::UpdatePatches()
+{
+    // 使用高度块时网格顶点与块的采样点一一对应，粗细块在接缝处的顶点高度一致
+    const int32 Resolution = TileStreamer.IsOpen()
+        ? TileStreamer.GetHeader().Samples - 1
+        : FMath::Max(2, PatchResolution + (PatchResolution & 1));
+    if (!PatchIndexCache.IsValid() || PatchIndexCache->Resolution != Resolution)
+    {
+        TSharedPtr<FTerrainPatchIndexCache, ESPMode::ThreadSafe> Cache = MakeShared<FTerrainPatchIndexCache, ESPMode::ThreadSafe>();
+        Cache->Build(Resolution);
+        PatchIndexCache = Cache;
+    }
+    if (RootNode)
+    {
+        UpdatePatches(*RootNode);
+    }
+}
+
+void AQuadTreeTerrain::UpdatePatches(QuadTreeNode& Node)
+{
+    if (IsSubdivided(Node))
+    {
+        // 已细分的节点不再显示网格块，等子节点的网格块就绪后回收
+        ReleaseMeshSection(Node.MeshSection);
+        Node.MeshSection = INDEX_NONE;
+        Node.bPatchPending = false;
+        for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+        {
+            UpdatePatches(GetChild(Node, Quadrant));
+        }
+        return;
+    }
+    
+    const uint8 Mask = ComputeStitchMask(Node);
+    const FTerrainHeightTilePtr Tile = RequestHeightTile(Node);
+    const int32 TileLevel = Tile.IsValid() ? Tile->Key.Z : INDEX_NONE;
+    const bool bHasPatch = Node.MeshSection != INDEX_NONE || Node.bPatchPending;
+    if (bHasPatch && Mask == Node.StitchMask && TileLevel == Node.PatchTileLevel) return;
+    
+    FTerrainPatchRequest Request;
+    Request.Center = Node.Center;
+    Request.Size = Node.Size;
+    Request.Origin = GetActorLocation();
+    Request.StitchMask = Mask;
+    Request.UVScale = UVScale;
+    Request.Height.HeightScale = HeightScale;
+    Request.Height.NoiseScale = NoiseScale;
+    Request.Height.Octaves = NoiseOctaves;
+    Request.Tile = Tile;
+    Request.IndexCache = PatchIndexCache;
+    
+    Node.StitchMask = Mask;
+    Node.PatchTileLevel = TileLevel;
+    Node.PatchSerial++;
+    Node.bPatchPending = true;
+    
+    FPatchJob& Job = PatchJobs.AddDefaulted_GetRef();
+    Job.Node = &Node;
+    Job.Serial = Node.PatchSerial;
+    Job.Result = Async(EAsyncExecution::ThreadPool, [Request]()
+    {
+        TSharedPtr<FTerrainPatchData, ESPMode::ThreadSafe> Data = MakeShared<FTerrainPatchData, ESPMode::ThreadSafe>();
+        BuildTerrainPatch(Request, *Data);
+        return Data;
+    });
+}
+
+void AQuadTreeTerrain::PollPatchJobs()
+{
+    for (int32 i = PatchJobs.Num() - 1; i >= 0; i--)
+    {
+        FPatchJob& Job = PatchJobs[i];
+        if (!Job.Result.IsReady()) continue;
+        
+        TSharedPtr<FTerrainPatchData, ESPMode::ThreadSafe> Data = Job.Result.Get();
+        QuadTreeNode& Node = *Job.Node;
+        // 节点已被合并/细分，或有更新的请求，结果作废
+        if (IsNodeActive(Node) && !IsSubdivided(Node) && Node.PatchSerial == Job.Serial && Data.IsValid())
+        {
+            if (Node.MeshSection == INDEX_NONE)
+            {
+                Node.MeshSection = AllocateMeshSection();
+            }
+            TerrainMesh->CreateMeshSection(Node.MeshSection, Data->Vertices, Data->Triangles, Data->Normals, Data->UVs,
+                TArray<FColor>(), TArray<FProcMeshTangent>(), false);
+            TerrainMesh->SetMaterial(Node.MeshSection, TerrainMaterial);
+            Node.bPatchPending = false;
+        }
+        PatchJobs.RemoveAtSwap(i, 1, false);
+    }
+    
+    if (PatchJobs.Num() == 0 && DeferredReleaseSections.Num() > 0)
+    {
+        for (int32 Section : DeferredReleaseSections)
+        {
+            TerrainMesh->ClearMeshSection(Section);
+            FreeMeshSections.Add(Section);
+        }
+        DeferredReleaseSections.Reset();
+    }
+}
+
+void AQuadTreeTerrain::OpenHeightTiles()
+{
+    const FString Path = FPaths::IsRelative(HeightTileFile) ? FPaths::ProjectSavedDir() / HeightTileFile : HeightTileFile;
+    if (!FPaths::FileExists(Path) && bGenerateHeightTiles)
+    {
+        FTerrainHeightParams Height;
+        Height.HeightScale = HeightScale;
+        Height.NoiseScale = NoiseScale;
+        Height.Octaves = NoiseOctaves;
+        const int32 Resolution = FMath::Max(2, PatchResolution + (PatchResolution & 1));
+        if (!FTerrainTileStreamer::WriteTileFile(Path, TerrainSize, Height, HeightTileLevels, Resolution + 1))
+        {
+            UE_LOG(LogTemp, Warning, TEXT("QuadTreeTerrain: failed to write %s"), *Path);
+        }
+    }
+    
+    if (!TileStreamer.Open(Path, ResidentTileLevels, MaxStreamedTiles))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("QuadTreeTerrain: %s unavailable, falling back to procedural height"), *Path);
+        TileStreamer.Close();
+        return;
+    }
+    if (!FVector2D(TileStreamer.GetHeader().TerrainSize).Equals(TerrainSize))
+    {
+        UE_LOG(LogTemp, Warning, TEXT("QuadTreeTerrain: %s was built for a different TerrainSize"), *Path);
+    }
+}
+
+FTerrainHeightTilePtr AQuadTreeTerrain::RequestHeightTile(const QuadTreeNode& Node)
+{
+    if (!TileStreamer.IsOpen()) return nullptr;
+    
+    // 文件坐标以Actor为中心
+    const FVector2D LocalCenter = Node.Center - FVector2D(GetActorLocation());
+    return TileStreamer.RequestTile(TileStreamer.GetTileKey(LocalCenter, Node.Depth));
+}
+
+bool AQuadTreeTerrain::AreChildTilesResident(const QuadTreeNode& Node)
+{
+    if (!bGenerateMesh || !TileStreamer.IsOpen()) return true;
+    
+    // 四个子节点中心各取一块；超出文件层数时与父节点同一块
+    const FVector2D LocalCenter = Node.Center - FVector2D(GetActorLocation());
+    bool bResident = true;
+    for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+    {
+        const FVector2D Offset((Quadrant & 1) ? 0.25f : -0.25f, (Quadrant & 2) ? 0.25f : -0.25f);
+        bResident &= TileStreamer.PrefetchTile(TileStreamer.GetTileKey(LocalCenter + Offset * Node.Size, Node.Depth + 1));
+    }
+    return bResident;
+}
+
+int32 AQuadTreeTerrain::AllocateMeshSection()
+{
+    return FreeMeshSections.Num() > 0 ? FreeMeshSections.Pop(false) : NextMeshSection++;
+}
+
+void AQuadTreeTerrain::ReleaseMeshSection(int32 Section)
+{
+    if (Section != INDEX_NONE)
+    {
+        DeferredReleaseSections.Add(Section);
+    }
+}
+
+void AQuadTreeTerrain::ClearTerrainMesh()
+{
+    // 进行中的任务结果全部作废
+    PatchJobs.Reset();
+    FreeMeshSections.Reset();
+    DeferredReleaseSections.Reset();
+    NextMeshSection = 0;
+    if (TerrainMesh)
+    {
+        TerrainMesh->ClearAllMeshSections();
+    }
+}
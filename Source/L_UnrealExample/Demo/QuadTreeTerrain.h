@@ -6,8 +6,34 @@
 #include "Components/WidgetComponent.h"
 #include "Blueprint/UserWidget.h"
 #include "GameFramework/Actor.h"
+#include "ConvexVolume.h"
+#include "QuadTreeTerrainMesh.h"
+#include "QuadTreeTerrainTiles.h"
 #include "QuadTreeTerrain.generated.h"
 
+class AHUD;
+class UCanvas;
+class UFont;
+class UMaterialInterface;
+class UProceduralMeshComponent;
+
+// 节点标签的显示方式
+UENUM()
+enum class ETerrainLabelMode : uint8
+{
+    Widget,     // 每个叶子一个屏幕空间Widget组件
+    Batched,    // 在HUD绘制时一次性绘制所有叶子的标签
+    None,
+};
+
+// LOD判定方式
+UENUM()
+enum class ETerrainLodMetric : uint8
+{
+    Distance,           // 距离与 SubdivideDistanceFactor / 2^Depth 比较
+    ScreenSpaceError,   // 投影到屏幕的几何误差与像素容差比较，视锥外的子树不细分
+};
+
 UCLASS()
 class L_UNREALEXAMPLE_API AQuadTreeTerrain : public AActor
 {
@@ -20,72 +46,298 @@ protected:
     virtual void BeginPlay() override;
     virtual void Tick(float DeltaTime) override;
     virtual void OnConstruction(const FTransform& Transform) override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
-    // 四叉树节点结构
+    // 自动化测试（QuadTreeTerrainTest.cpp）直接检查树的内部状态
+    friend struct FQuadTreeTerrainTestAccess;
+    
+    // 四叉树节点结构：按层分页存放，子节点由网格坐标隐式计算，是否细分记录在SubdividedBits
     struct QuadTreeNode
     {
         FVector2D Center;      // 中心位置
         FVector2D Size;         // 节点尺寸
         int Depth = 0;          // 节点深度
-        bool IsSubdivided = false; // 是否已细分
-        
-        // 四个子节点 (西北, 东北, 西南, 东南)
-        TSharedPtr<QuadTreeNode> NW;
-        TSharedPtr<QuadTreeNode> NE;
-        TSharedPtr<QuadTreeNode> SW;
-        TSharedPtr<QuadTreeNode> SE;
+        int32 X = 0;            // 本层网格坐标，X向东，Y向北
+        int32 Y = 0;
         
         // 该节点对应的Widget组件
         UWidgetComponent* WidgetComponent = nullptr;
         
-        QuadTreeNode(const FVector2D& InCenter, const FVector2D& InSize, int InDepth)
-            : Center(InCenter), Size(InSize), Depth(InDepth) {}
+        // 地形网格块：所在的网格段、生成时使用的接缝掩码、请求序号
+        int32 MeshSection = INDEX_NONE;
+        uint8 StitchMask = 0;
+        uint32 PatchSerial = 0;
+        bool bPatchPending = false;
+        int32 PatchTileLevel = INDEX_NONE; // 当前网格块所用高度块的层级，目标块加载后重建
+        
+        // 增量LOD：评估后视图里程增加不超过LodSlack时，子树内的分裂/合并结果不会改变
+        double LodEvalOdometer = 0.0;
+        float LodSlack = 0.f;
+        bool bLodQueued = false; // 已有待执行的分裂/合并操作
     };
     
-    // 根节点
-    TSharedPtr<QuadTreeNode> RootNode;
+    // 子节点顺序 (西北, 东北, 西南, 东南)
+    enum EChildQuadrant : int32 { Child_NW, Child_NE, Child_SW, Child_SE };
+    
+    // 第 D 层 2^D x 2^D 个节点按 8x8 分页（前三层各一页），页在第一次细分出其中的节点时分配，保留到ClearQuadTree
+    // 节点地址因此在树的生命期内不变（LOD命令和网格任务持有节点指针）；再次分裂/合并只翻转细分位
+    static constexpr int32 NodePageShift = 3;
+    TArray<TArray<TUniquePtr<QuadTreeNode[]>>> NodePages;
+    TArray<TBitArray<>> SubdividedBits;
+    
+    // 根节点，指向NodePages[0][0][0]
+    QuadTreeNode* RootNode = nullptr;
+    
+    static int32 GetLevelIndex(const QuadTreeNode& Node) { return (Node.Y << Node.Depth) + Node.X; }
+    
+    static int32 GetPageSide(int32 Depth) { return 1 << FMath::Min(Depth, NodePageShift); }
+    static int32 GetPageIndex(int32 Depth, int32 X, int32 Y) { return ((Y >> NodePageShift) << FMath::Max(Depth - NodePageShift, 0)) + (X >> NodePageShift); }
+    static int32 GetInPageIndex(int32 Depth, int32 X, int32 Y)
+    {
+        const int32 Mask = GetPageSide(Depth) - 1;
+        return ((Y & Mask) << FMath::Min(Depth, NodePageShift)) + (X & Mask);
+    }
+    
+    // 按层和网格坐标查找节点，所在页未分配时返回空
+    QuadTreeNode* FindLevelNode(int32 Depth, int32 X, int32 Y)
+    {
+        const TUniquePtr<QuadTreeNode[]>& Page = NodePages[Depth][GetPageIndex(Depth, X, Y)];
+        return Page ? &Page[GetInPageIndex(Depth, X, Y)] : nullptr;
+    }
+    const QuadTreeNode* FindLevelNode(int32 Depth, int32 X, int32 Y) const
+    {
+        const TUniquePtr<QuadTreeNode[]>& Page = NodePages[Depth][GetPageIndex(Depth, X, Y)];
+        return Page ? &Page[GetInPageIndex(Depth, X, Y)] : nullptr;
+    }
+    
+    // 分配Node的子节点所在的页（已分配时不做任何事）
+    void AllocateChildren(const QuadTreeNode& Node);
+    
+    bool IsSubdivided(const QuadTreeNode& Node) const { return SubdividedBits[Node.Depth][GetLevelIndex(Node)]; }
+    void SetSubdivided(const QuadTreeNode& Node, bool bSubdivided) { SubdividedBits[Node.Depth][GetLevelIndex(Node)] = bSubdivided; }
+    
+    // 隐式子节点：下一层坐标 (2X + 东, 2Y + 北)；只对已细分的节点调用，子节点页一定已分配
+    static FIntPoint GetChildCoord(const QuadTreeNode& Node, int32 Quadrant)
+    {
+        return FIntPoint(
+            Node.X * 2 + (Quadrant == Child_NE || Quadrant == Child_SE ? 1 : 0),
+            Node.Y * 2 + (Quadrant == Child_NW || Quadrant == Child_NE ? 1 : 0));
+    }
+    QuadTreeNode& GetChild(const QuadTreeNode& Node, int32 Quadrant)
+    {
+        const FIntPoint Coord = GetChildCoord(Node, Quadrant);
+        QuadTreeNode* Child = FindLevelNode(Node.Depth + 1, Coord.X, Coord.Y);
+        check(Child);
+        return *Child;
+    }
+    const QuadTreeNode& GetChild(const QuadTreeNode& Node, int32 Quadrant) const
+    {
+        const FIntPoint Coord = GetChildCoord(Node, Quadrant);
+        const QuadTreeNode* Child = FindLevelNode(Node.Depth + 1, Coord.X, Coord.Y);
+        check(Child);
+        return *Child;
+    }
+    
+    // 节点当前是否在树中：根节点，或父节点已细分（合并时整棵子树的细分位都会清除）
+    bool IsNodeActive(const QuadTreeNode& Node) const
+    {
+        return Node.Depth == 0 || SubdividedBits[Node.Depth - 1][((Node.Y >> 1) << (Node.Depth - 1)) + (Node.X >> 1)];
+    }
     
     // 构建四叉树
     void BuildQuadTree();
     
     // 递归细分节点
-    void SubdivideNode(TSharedPtr<QuadTreeNode> Node, const FVector& CameraLocation);
+    void SubdivideNode(QuadTreeNode& Node);
+    
+    // 细分一个叶子节点，激活四个子节点并创建其Widget
+    void SplitNode(QuadTreeNode& Node);
     
-    // 递归合并节点
-    void MergeNodes(TSharedPtr<QuadTreeNode> Node, const FVector& CameraLocation);
+    // 合并节点，回收整棵子树
+    void MergeNodes(QuadTreeNode& Node);
     
     // 创建或更新Widget组件
-    void CreateOrUpdateWidget(TSharedPtr<QuadTreeNode> Node);
+    void CreateOrUpdateWidget(QuadTreeNode& Node);
     
     // 删除节点及其Widget
-    void RemoveNodeAndWidget(TSharedPtr<QuadTreeNode> Node);
+    void RemoveNodeAndWidget(QuadTreeNode& Node);
     
     // 绘制调试信息
-    void DrawDebugQuadTree(TSharedPtr<QuadTreeNode> Node);
+    void DrawDebugQuadTree(const QuadTreeNode& Node);
     
-    // 获取摄像机位置
-    FVector GetCameraLocation() const;
+    // LOD视图：每个本地玩家（分屏时各一个）的摄像机，以及AdditionalViewers；每帧缓存一次
+    struct FLodView
+    {
+        FVector Location = FVector::ZeroVector;
+        FRotator Rotation = FRotator::ZeroRotator;
+        FConvexVolume Frustum;
+        float ProjectionScale = 0.f; // 视口宽度 / (2 * tan(FOV / 2))，世界误差 * ProjectionScale / 距离 = 像素误差
+        bool bHasFrustum = false;    // 额外视点没有视锥，不参与裁剪
+    };
+    TArray<FLodView> LodViews;
+    
+    // 收集本帧的LOD视图
+    void UpdateLodViews();
     
     // 计算节点到摄像机的距离
-    float GetDistanceToCamera(const FVector2D& NodeCenter) const;
+    float GetDistanceToCamera(const FVector2D& NodeCenter, const FVector& CameraLocation) const;
+    
+    // 任一视图到节点的距离小于细分阈值
+    bool ShouldSubdivide(const QuadTreeNode& Node) const;
+    
+    // 所有视图都认为节点应该合并
+    bool ShouldMerge(const QuadTreeNode& Node) const;
+    
+    // 四个子节点是否都应该合并
+    bool ShouldMergeChildren(const QuadTreeNode& Node) const;
+    
+    // 分步LOD：遍历只把分裂/合并放入按误差排序的队列，每帧在预算内执行
+    struct FLodOp
+    {
+        QuadTreeNode* Node = nullptr; // 执行时节点可能已不在树中，用IsNodeActive检查
+        float Priority = 0.f; // 当前误差与阈值之比，越大越急
+        bool bSplit = false;
+        
+        // 堆顶为优先级最高的操作
+        bool operator<(const FLodOp& Other) const { return Priority > Other.Priority; }
+    };
+    TArray<FLodOp> LodQueue;
+    
+    void QueueLodOp(QuadTreeNode& Node, bool bSplit);
+    void DrainLodQueue();
+    float GetLodPriority(const QuadTreeNode& Node, bool bSplit) const;
+    
+    // 并行LOD：判定阶段只读树结构、只写各自子树的LOD字段，按子树并行，输出分裂/合并命令；
+    // 命令在游戏线程一次性执行（创建/回收Widget等UObject操作）
+    void EvaluateLodParallel();
+    void CollectLodFrontier(QuadTreeNode& Node, TArray<QuadTreeNode*>& OutFrontier, TArray<QuadTreeNode*>& OutUpper);
+    void EvaluateLod(QuadTreeNode& Node, TArray<FLodOp>& OutCommands);
+    void EvaluateLodMerge(QuadTreeNode& Node, TArray<FLodOp>& OutCommands);
+    void ApplyLodCommands(const TArray<FLodOp>& Commands);
+    
+    // 任一视图移动超过阈值、视角变化或树被LOD遍历以外的操作修改时才需要重新评估
+    bool ShouldUpdateLod();
     
-    // 计算摄像机到节点的距离是否小于细分阈值
-    bool ShouldSubdivide(const QuadTreeNode& Node, const FVector& CameraLocation) const;
+    // 每层的分裂/合并距离带半径：节点到视图的距离越过半径时判定结果才会改变
+    // 屏幕空间误差模式下不含ProjectionScale，按视图乘上GetBandScale
+    void UpdateLodBands();
+    float GetBandScale(const FLodView& View) const;
     
-    // 计算节点是否应该合并
-    bool ShouldMerge(const QuadTreeNode& Node, const FVector& CameraLocation) const;
+    // 与判定一致的节点距离：距离判定用节点中心，屏幕空间误差用包围盒
+    float GetLodDistance(const QuadTreeNode& Node, const FLodView& View) const;
+    
+    // 节点自身的判定在所有视图移动多远之内保持不变
+    float GetLodSlack(const QuadTreeNode& Node) const;
+    
+    // 包围盒与视锥的相交结果在摄像机平移多远之内保持不变
+    float GetFrustumSlack(const FBox& Bounds, const FLodView& View) const;
+    
+    TArray<float> SplitBands;
+    TArray<float> MergeBands;
+    TArray<FLodView> LastLodViews;
+    double LodOdometer = 0.0;         // 每次评估时累加各视图中最大的位移
+    bool bLodStale = true;           // 树在LOD遍历之外被修改（构建、2:1平衡），下次完整评估
+    bool bInLodWalk = false;
+    bool bLodIncrementalPass = false; // 本次遍历可以跳过LodSlack内的子树
+    
+    // 节点包围盒（Z方向为 0 到 NodeBoundsHeight）
+    FBox GetNodeBounds(const FVector2D& Center, const FVector2D& Size) const;
+    
+    // 节点在视图中的屏幕空间误差（像素）；Size为误差对应的节点尺寸
+    float GetScreenSpaceError(const QuadTreeNode& Node, const FVector2D& Size, const FLodView& View) const;
+    
+    // 节点是否与视图的视锥相交
+    bool IsNodeVisible(const QuadTreeNode& Node, const FLodView& View) const;
     
     // 清除整个四叉树
     void ClearQuadTree();
+
+    // 点所在的叶子节点，点在地形外时返回空
+    QuadTreeNode* FindLeaf(const FVector2D& Point);
+    
+    // 点所在的、深度不超过MaxNodeDepth的最深节点
+    QuadTreeNode* FindNode(const FVector2D& Point, int32 MaxNodeDepth);
+    
+    // 节点某条边（ETerrainPatchEdge）外侧、紧贴边中点的采样点
+    FVector2D GetEdgeProbe(const QuadTreeNode& Node, uint8 Edge) const;
+    
+    // 2:1平衡：相邻叶子的深度差不超过1，细分后调用，必要时继续细分较粗的邻居
+    void BalanceTree();
+    
+    // 合并后该节点的邻居是否仍满足2:1平衡
+    bool CanMerge(const QuadTreeNode& Node) const;
+    
+    // 比相邻叶子细的边
+    uint8 ComputeStitchMask(const QuadTreeNode& Node);
+    
+    // 为需要的叶子提交网格生成任务，回收非叶子节点的网格段
+    void UpdatePatches();
+    void UpdatePatches(QuadTreeNode& Node);
+    
+    // 把已完成的任务上传到网格组件
+    void PollPatchJobs();
+    
+    // 网格段分配；释放延迟到没有进行中的任务时，避免新网格块就绪前出现空洞
+    int32 AllocateMeshSection();
+    void ReleaseMeshSection(int32 Section);
+    void ClearTerrainMesh();
+    
+    UPROPERTY(VisibleAnywhere, Category = "QuadTree|Mesh")
+    UProceduralMeshComponent* TerrainMesh;
+    
+    struct FPatchJob
+    {
+        QuadTreeNode* Node = nullptr; // 节点存储在重建树之前一直有效，结果按Serial判断是否作废
+        uint32 Serial = 0;
+        TFuture<TSharedPtr<FTerrainPatchData, ESPMode::ThreadSafe>> Result;
+    };
+    TArray<FPatchJob> PatchJobs;
+    TSharedPtr<const FTerrainPatchIndexCache, ESPMode::ThreadSafe> PatchIndexCache;
+    TArray<int32> FreeMeshSections;
+    TArray<int32> DeferredReleaseSections;
+    int32 NextMeshSection = 0;
+    bool bTopologyChanged = false; // 本帧有节点分裂或合并
+    
+    // 打开高度块文件，不存在时按需生成
+    void OpenHeightTiles();
+    
+    // 节点对应的高度块：层级等于节点深度，超出文件层数时取最细一层
+    FTerrainHeightTilePtr RequestHeightTile(const QuadTreeNode& Node);
+    
+    // 四个子节点的高度块是否都已加载，未加载的发起读取
+    // LOD细分等子块就绪后才执行，父节点的网格块保留到那时；否则子节点用祖先块建网格，
+    // 和已是全分辨率的邻居在接缝处高度不一致。2:1平衡的细分不等待，仍可能短暂使用祖先块
+    bool AreChildTilesResident(const QuadTreeNode& Node);
+    
+    FTerrainTileStreamer TileStreamer;
+    
+    // 是否为节点创建Widget组件
+    bool UsesWidgetLabels() const { return LabelMode == ETerrainLabelMode::Widget && WidgetClass; }
+    
+    // 批量绘制所有叶子的标签，由AHUD::OnHUDPostRender调用
+    void DrawLabels(AHUD* HUD, UCanvas* Canvas);
+    
+    FDelegateHandle HUDPostRenderHandle;
+    
+    // Widget组件池：分裂/合并时回收复用，避免反复创建和销毁UObject
+    UWidgetComponent* AcquireWidget();
+    UWidgetComponent* CreatePooledWidget();
+    void ReleaseWidget(UWidgetComponent* Widget);
+    void WarmWidgetPool();
+    void EmptyWidgetPool();
+
+    // 空闲的Widget组件，已注册但隐藏
+    UPROPERTY(Transient)
+    TArray<UWidgetComponent*> WidgetPool;
     
 public:
     // 配置参数
     UPROPERTY(EditAnywhere, Category = "QuadTree")
     FVector2D TerrainSize = FVector2D(2000.f, 2000.f); // 地形尺寸
     
-    UPROPERTY(EditAnywhere, Category = "QuadTree", meta = (ClampMin = "1"))
-    int MaxDepth = 5; // 最大细分深度
+    UPROPERTY(EditAnywhere, Category = "QuadTree", meta = (ClampMin = "1", ClampMax = "10"))
+    int MaxDepth = 5; // 最大细分深度；节点按页在细分时分配，完全细分时共 (4^(MaxDepth+1)-1)/3 个（每个 96 字节），10 层为 140 万个、128 MB
     
     UPROPERTY(EditAnywhere, Category = "QuadTree", meta = (ClampMin = "0.0"))
     float SubdivideDistanceFactor = 1000.f; // 细分距离因子
@@ -93,6 +345,90 @@ public:
     UPROPERTY(EditAnywhere, Category = "QuadTree", meta = (ClampMin = "0.0"))
     float MergeDistanceFactor = 2000.f; // 合并距离因子
     
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    ETerrainLodMetric LodMetric = ETerrainLodMetric::Distance;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.1"))
+    float PixelTolerance = 4.f; // 允许的屏幕空间误差（像素）
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0"))
+    float GeometricErrorFactor = 1.f / 16.f; // 节点几何误差 = 节点尺寸 * 系数，对应每个节点 16 格的网格
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+    float MergeHysteresis = 0.75f; // 父节点误差低于 PixelTolerance * 该系数时才合并，避免边界处反复分裂合并
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    bool bFrustumCull = true; // 视锥外的子树不细分，并尽快合并
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0"))
+    float NodeBoundsHeight = 100.f; // 节点包围盒的高度
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    TArray<AActor*> AdditionalViewers; // 本地玩家之外参与LOD选择的视点，如观战摄像机
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    bool bParallelLod = false; // 按子树并行判定分裂/合并，游戏线程批量执行；每次评估每个叶子最多细分一级，需要多帧才能收敛
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "1", ClampMax = "6", EditCondition = "bParallelLod"))
+    int32 ParallelLodDepth = 3; // 以该深度的节点为根划分并行任务，最多 4^ParallelLodDepth 个
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    bool bIncrementalLod = false; // 摄像机静止时跳过LOD评估，移动时只评估可能越过距离带的子树
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0", EditCondition = "bIncrementalLod"))
+    float LodMoveThreshold = 10.f; // 摄像机移动超过该距离才重新评估
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0", EditCondition = "bIncrementalLod"))
+    float LodRotationThreshold = 1.f; // 屏幕空间误差模式下，视角转动超过该角度（度）时完整评估
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD")
+    bool bTimeSliceLod = false; // 分裂/合并按误差排队，每帧在预算内执行，摄像机跳跃时分几帧收敛
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0", EditCondition = "bTimeSliceLod"))
+    int32 MaxLodOpsPerFrame = 16; // 每帧最多执行的分裂/合并次数，0 为不限
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|LOD", meta = (ClampMin = "0.0", EditCondition = "bTimeSliceLod"))
+    float LodTimeBudgetMs = 1.f; // 每帧执行分裂/合并的时间预算（毫秒），0 为不限；每帧至少执行一次
+
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh")
+    bool bGenerateMesh = false; // 为每个叶子生成地形网格块，同时启用2:1平衡
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh", meta = (ClampMin = "2", ClampMax = "128"))
+    int32 PatchResolution = 16; // 每个网格块每边的格数，取偶数
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh")
+    float HeightScale = 200.f;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh")
+    float NoiseScale = 0.0015f;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh", meta = (ClampMin = "1", ClampMax = "8"))
+    int32 NoiseOctaves = 4;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh")
+    float UVScale = 0.001f;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Mesh")
+    UMaterialInterface* TerrainMaterial = nullptr;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming")
+    bool bStreamHeightTiles = false; // 从分块高度场文件按需加载高度，代替程序化噪声
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming")
+    FString HeightTileFile = TEXT("QuadTreeTerrain.qthf"); // 相对路径基于 Saved 目录
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming")
+    bool bGenerateHeightTiles = true; // 文件不存在时由程序化高度场生成，块边长取 PatchResolution + 1
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming", meta = (ClampMin = "1", ClampMax = "10"))
+    int32 HeightTileLevels = 6; // 生成文件的层数
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming", meta = (ClampMin = "1"))
+    int32 ResidentTileLevels = 2; // 常驻内存的粗层数
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Streaming", meta = (ClampMin = "1"))
+    int32 MaxStreamedTiles = 256; // 常驻层之外最多保留的块数，超出按LRU淘汰
+
     UPROPERTY(EditAnywhere, Category = "QuadTree")
     bool bDrawDebug = true; // 是否绘制调试信息
     
@@ -107,4 +443,22 @@ public:
 
     UPROPERTY(EditAnywhere, Category= "QuadTree")
     float WidgetHeight = 100.0f;
+
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Label")
+    ETerrainLabelMode LabelMode = ETerrainLabelMode::Widget;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Label")
+    UFont* LabelFont = nullptr; // 为空时使用引擎的小字体
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Label")
+    FLinearColor LabelColor = FLinearColor::White;
+    
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Label", meta = (ClampMin = "0.1"))
+    float LabelScale = 1.0f;
+
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Pool", meta = (ClampMin = "0"))
+    int32 WidgetPoolWarmSize = 32; // BeginPlay时预先创建的数量
+
+    UPROPERTY(EditAnywhere, Category = "QuadTree|Pool", meta = (ClampMin = "0"))
+    int32 WidgetPoolMaxSize = 256; // 空闲数量上限，超出的部分直接销毁
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+﻿#include "QuadTreeTerrainMesh.h"
+#include "QuadTreeTerrainTiles.h"
+
+float FTerrainHeightParams::SampleHeight(const FVector2D& WorldXY) const
+{
+    float Height = 0.f;
+    float Amplitude = 1.f;
+    float Frequency = NoiseScale;
+    for (int32 i = 0; i < Octaves; i++)
+    {
+        Height += FMath::PerlinNoise2D(WorldXY * Frequency) * Amplitude;
+        Amplitude *= 0.5f;
+        Frequency *= 2.f;
+    }
+    return Height * HeightScale;
+}
+
+void FTerrainPatchIndexCache::Build(int32 InResolution)
+{
+    Resolution = InResolution;
+    const int32 Stride = Resolution + 1;
+    auto Vertex = [Stride](int32 X, int32 Y) { return Y * Stride + X; };
+    
+    for (int32 Mask = 0; Mask < 16; Mask++)
+    {
+        // 边上的奇数顶点映射到前一个偶数顶点
+        auto Remap = [&](int32 X, int32 Y)
+        {
+            if ((Mask & TerrainEdge_West) && X == 0 && (Y & 1)) Y--;
+            else if ((Mask & TerrainEdge_East) && X == Resolution && (Y & 1)) Y--;
+            else if ((Mask & TerrainEdge_South) && Y == 0 && (X & 1)) X--;
+            else if ((Mask & TerrainEdge_North) && Y == Resolution && (X & 1)) X--;
+            return Vertex(X, Y);
+        };
+        
+        TArray<int32>& Out = Indices[Mask];
+        Out.Reset(Resolution * Resolution * 6);
+        auto AddTriangle = [&Out](int32 A, int32 B, int32 C)
+        {
+            if (A != B && B != C && A != C) // 合并后退化的三角形直接丢弃
+            {
+                Out.Add(A);
+                Out.Add(B);
+                Out.Add(C);
+            }
+        };
+        for (int32 Y = 0; Y < Resolution; Y++)
+        {
+            for (int32 X = 0; X < Resolution; X++)
+            {
+                const int32 V00 = Remap(X, Y);
+                const int32 V10 = Remap(X + 1, Y);
+                const int32 V11 = Remap(X + 1, Y + 1);
+                const int32 V01 = Remap(X, Y + 1);
+                // 从上方看为顺时针，正面朝 +Z
+                AddTriangle(V00, V10, V11);
+                AddTriangle(V00, V11, V01);
+            }
+        }
+    }
+}
+
+void BuildTerrainPatch(const FTerrainPatchRequest& Request, FTerrainPatchData& OutData)
+{
+    const int32 Resolution = Request.IndexCache->Resolution;
+    const int32 Stride = Resolution + 1;
+    const FVector2D Min = Request.Center - Request.Size * 0.5f;
+    const FVector2D Step = Request.Size / Resolution;
+    const FVector2D Origin2D(Request.Origin);
+    auto SampleHeight = [&Request, &Origin2D](const FVector2D& P)
+    {
+        return Request.Tile ? Request.Tile->Sample(P - Origin2D) : Request.Height.SampleHeight(P);
+    };
+    
+    OutData.Vertices.SetNumUninitialized(Stride * Stride);
+    OutData.Normals.SetNumUninitialized(Stride * Stride);
+    OutData.UVs.SetNumUninitialized(Stride * Stride);
+    for (int32 Y = 0; Y < Stride; Y++)
+    {
+        for (int32 X = 0; X < Stride; X++)
+        {
+            const int32 Index = Y * Stride + X;
+            const FVector2D P = Min + FVector2D(X * Step.X, Y * Step.Y);
+            const float H = SampleHeight(P);
+            OutData.Vertices[Index] = FVector(P.X, P.Y, H) - Request.Origin;
+            OutData.UVs[Index] = P * Request.UVScale;
+            
+            // 中心差分直接采样高度场，相邻网格块在接缝处的法线一致
+            const float HX = SampleHeight(P + FVector2D(Step.X, 0.f)) - SampleHeight(P - FVector2D(Step.X, 0.f));
+            const float HY = SampleHeight(P + FVector2D(0.f, Step.Y)) - SampleHeight(P - FVector2D(0.f, Step.Y));
+            OutData.Normals[Index] = FVector(-HX / (2.f * Step.X), -HY / (2.f * Step.Y), 1.f).GetSafeNormal();
+        }
+    }
+    OutData.Triangles = Request.IndexCache->Indices[Request.StitchMask & 15];
+}
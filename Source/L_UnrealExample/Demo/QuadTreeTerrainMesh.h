@@ -0,0 +1,61 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTerrainHeightTile;
+
+// 接缝掩码：该方向的邻居比本节点粗一级时置位
+enum ETerrainPatchEdge : uint8
+{
+    TerrainEdge_West  = 1 << 0, // -X
+    TerrainEdge_East  = 1 << 1, // +X
+    TerrainEdge_South = 1 << 2, // -Y
+    TerrainEdge_North = 1 << 3, // +Y
+};
+
+// 高度场参数，按值拷贝给工作线程
+struct FTerrainHeightParams
+{
+    float HeightScale = 200.f;
+    float NoiseScale = 0.0015f;
+    int32 Octaves = 4;
+    
+    // 线程安全：只依赖参数本身
+    float SampleHeight(const FVector2D& WorldXY) const;
+};
+
+// 16 种接缝掩码对应的索引缓冲：粗邻居一侧的奇数顶点合并到相邻的偶数顶点，边上只剩与邻居一致的顶点
+struct FTerrainPatchIndexCache
+{
+    int32 Resolution = 0;
+    TArray<int32> Indices[16];
+    
+    void Build(int32 InResolution);
+};
+
+// 一个叶子网格块的生成请求
+struct FTerrainPatchRequest
+{
+    FVector2D Center;
+    FVector2D Size;
+    FVector Origin;         // Actor位置，顶点转换到组件空间
+    uint8 StitchMask = 0;
+    float UVScale = 0.001f;
+    FTerrainHeightParams Height;
+    TSharedPtr<const FTerrainHeightTile, ESPMode::ThreadSafe> Tile; // 有效时从高度块采样，否则用程序化高度场
+    TSharedPtr<const FTerrainPatchIndexCache, ESPMode::ThreadSafe> IndexCache;
+};
+
+// 生成结果
+struct FTerrainPatchData
+{
+    TArray<FVector> Vertices;
+    TArray<FVector> Normals;
+    TArray<FVector2D> UVs;
+    TArray<int32> Triangles;
+};
+
+// 在工作线程生成网格块
+void BuildTerrainPatch(const FTerrainPatchRequest& Request, FTerrainPatchData& OutData);
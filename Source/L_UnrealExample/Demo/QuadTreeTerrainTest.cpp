@@ -0,0 +1,248 @@
+﻿#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTreeTerrain.h"
+#include "Camera/CameraActor.h"
+#include "Tests/QuadTreeTestWorld.h"
+
+struct FQuadTreeTerrainTestAccess
+{
+    typedef AQuadTreeTerrain::QuadTreeNode FNode;
+    
+    static FNode* Root(AQuadTreeTerrain& Terrain) { return Terrain.RootNode; }
+    static FNode* FindLeaf(AQuadTreeTerrain& Terrain, const FVector2D& Point) { return Terrain.FindLeaf(Point); }
+    static FNode* FindNeighbor(AQuadTreeTerrain& Terrain, const FNode& Node, uint8 Edge) { return Terrain.FindLeaf(Terrain.GetEdgeProbe(Node, Edge)); }
+    static uint8 ComputeStitchMask(AQuadTreeTerrain& Terrain, const FNode& Node) { return Terrain.ComputeStitchMask(Node); }
+    static void BalanceTree(AQuadTreeTerrain& Terrain) { Terrain.BalanceTree(); }
+    static void MergeNodes(AQuadTreeTerrain& Terrain, FNode& Node) { Terrain.MergeNodes(Node); }
+    
+    static void Rebuild(AQuadTreeTerrain& Terrain, int32 MaxDepth)
+    {
+        Terrain.MaxDepth = MaxDepth;
+        Terrain.ClearQuadTree();
+        Terrain.BuildQuadTree();
+    }
+    
+    static void CollectLeaves(AQuadTreeTerrain& Terrain, TArray<FNode*>& OutLeaves)
+    {
+        TArray<FNode*> Stack;
+        Stack.Add(Terrain.RootNode);
+        while (Stack.Num() > 0)
+        {
+            FNode* Node = Stack.Pop(false);
+            if (!Terrain.IsSubdivided(*Node))
+            {
+                OutLeaves.Add(Node);
+                continue;
+            }
+            for (int32 Quadrant = 0; Quadrant < 4; Quadrant++)
+            {
+                Stack.Add(&Terrain.GetChild(*Node, Quadrant));
+            }
+        }
+    }
+    
+    // 沿覆盖Point的路径一直细分到Depth层
+    static void SplitToward(AQuadTreeTerrain& Terrain, const FVector2D& Point, int32 Depth)
+    {
+        for (FNode* Leaf = Terrain.FindLeaf(Point); Leaf && Leaf->Depth < Depth; Leaf = Terrain.FindLeaf(Point))
+        {
+            Terrain.SplitNode(*Leaf);
+        }
+    }
+    
+    static int32 CountPages(const AQuadTreeTerrain& Terrain)
+    {
+        int32 Pages = 0;
+        for (const auto& Level : Terrain.NodePages)
+        {
+            for (const auto& Page : Level)
+            {
+                Pages += Page.IsValid() ? 1 : 0;
+            }
+        }
+        return Pages;
+    }
+    
+    // 按Tick中的顺序评估LOD（不生成网格），共Passes次
+    static void RunLod(AQuadTreeTerrain& Terrain, int32 Passes)
+    {
+        for (int32 Pass = 0; Pass < Passes; Pass++)
+        {
+            Terrain.UpdateLodViews();
+            if (!Terrain.ShouldUpdateLod()) continue;
+            Terrain.bInLodWalk = true;
+            if (Terrain.bParallelLod)
+            {
+                Terrain.EvaluateLodParallel();
+            }
+            else
+            {
+                Terrain.SubdivideNode(*Terrain.RootNode);
+            }
+            Terrain.bInLodWalk = false;
+        }
+    }
+    
+    // 叶子的 (X, Y, Depth)，排序后便于比较两棵树
+    static TArray<FIntVector> GetLeafKeys(AQuadTreeTerrain& Terrain)
+    {
+        TArray<FNode*> Leaves;
+        CollectLeaves(Terrain, Leaves);
+        TArray<FIntVector> Keys;
+        for (const FNode* Leaf : Leaves)
+        {
+            Keys.Add(FIntVector(Leaf->X, Leaf->Y, Leaf->Depth));
+        }
+        Keys.Sort([](const FIntVector& A, const FIntVector& B)
+        {
+            return A.Z != B.Z ? A.Z < B.Z : A.Y != B.Y ? A.Y < B.Y : A.X < B.X;
+        });
+        return Keys;
+    }
+};
+
+namespace QuadTreeTerrainTest
+{
+    const uint8 Edges[] = { TerrainEdge_West, TerrainEdge_East, TerrainEdge_South, TerrainEdge_North };
+    
+    uint8 OppositeEdge(uint8 Edge)
+    {
+        switch (Edge)
+        {
+        case TerrainEdge_West:  return TerrainEdge_East;
+        case TerrainEdge_East:  return TerrainEdge_West;
+        case TerrainEdge_South: return TerrainEdge_North;
+        default:                return TerrainEdge_South;
+        }
+    }
+}
+
+// 2:1平衡后相邻叶子最多差一级；接缝掩码只标记更粗的一侧，且粗邻居不会反过来向细的一侧缝合
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeTerrainBalanceTest, "L_UnrealExample.QuadTreeTerrain.BalanceAndStitch",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeTerrainBalanceTest::RunTest(const FString& Parameters)
+{
+    typedef FQuadTreeTerrainTestAccess FAccess;
+    FQuadTreeTestWorld TestWorld;
+    AQuadTreeTerrain* Terrain = TestWorld.Spawn<AQuadTreeTerrain>(FVector::ZeroVector);
+    FAccess::Rebuild(*Terrain, 6);
+    
+    // 在中心附近细分到最深，周围仍是很粗的叶子
+    FAccess::SplitToward(*Terrain, FVector2D(1.0, 1.0), 6);
+    TArray<FAccess::FNode*> Leaves;
+    FAccess::CollectLeaves(*Terrain, Leaves);
+    bool bUnbalanced = false;
+    for (FAccess::FNode* Leaf : Leaves)
+    {
+        for (uint8 Edge : QuadTreeTerrainTest::Edges)
+        {
+            const FAccess::FNode* Neighbor = FAccess::FindNeighbor(*Terrain, *Leaf, Edge);
+            bUnbalanced |= Neighbor && Neighbor->Depth < Leaf->Depth - 1;
+        }
+    }
+    TestTrue(TEXT("tree is unbalanced before BalanceTree"), bUnbalanced);
+    
+    FAccess::BalanceTree(*Terrain);
+    Leaves.Reset();
+    FAccess::CollectLeaves(*Terrain, Leaves);
+    for (FAccess::FNode* Leaf : Leaves)
+    {
+        const uint8 Mask = FAccess::ComputeStitchMask(*Terrain, *Leaf);
+        for (uint8 Edge : QuadTreeTerrainTest::Edges)
+        {
+            const FAccess::FNode* Neighbor = FAccess::FindNeighbor(*Terrain, *Leaf, Edge);
+            if (!Neighbor)
+            {
+                TestFalse(TEXT("terrain border is not stitched"), (Mask & Edge) != 0);
+                continue;
+            }
+            TestTrue(TEXT("neighbors differ by at most one level"), Neighbor->Depth >= Leaf->Depth - 1);
+            TestEqual(TEXT("stitched exactly toward coarser neighbors"), (Mask & Edge) != 0, Neighbor->Depth < Leaf->Depth);
+            if (Mask & Edge)
+            {
+                const uint8 NeighborMask = FAccess::ComputeStitchMask(*Terrain, *Neighbor);
+                TestFalse(TEXT("coarser neighbor does not stitch back"), (NeighborMask & QuadTreeTerrainTest::OppositeEdge(Edge)) != 0);
+            }
+        }
+    }
+    return true;
+}
+
+// 节点页在第一次细分时分配：构建时只有根节点；沿一条路径细分每层只多一页；合并后再细分复用同一节点
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeTerrainPagedStorageTest, "L_UnrealExample.QuadTreeTerrain.PagedStorage",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeTerrainPagedStorageTest::RunTest(const FString& Parameters)
+{
+    typedef FQuadTreeTerrainTestAccess FAccess;
+    FQuadTreeTestWorld TestWorld;
+    AQuadTreeTerrain* Terrain = TestWorld.Spawn<AQuadTreeTerrain>(FVector(300.f, -200.f, 0.f));
+    FAccess::Rebuild(*Terrain, 12);
+    TestEqual(TEXT("depth clamped to the measured limit"), Terrain->MaxDepth, 10);
+    TestEqual(TEXT("only the root page allocated at build"), FAccess::CountPages(*Terrain), 1);
+    
+    FAccess::FNode* Root = FAccess::Root(*Terrain);
+    const FVector2D Point = Root->Center + Terrain->TerrainSize * FVector2D(0.31, -0.17);
+    FAccess::SplitToward(*Terrain, Point, 10);
+    TestEqual(TEXT("one page per refined level"), FAccess::CountPages(*Terrain), 11);
+    
+    // 子节点的几何由网格坐标得到，与父节点一致
+    TArray<FAccess::FNode*> Leaves;
+    FAccess::CollectLeaves(*Terrain, Leaves);
+    for (const FAccess::FNode* Leaf : Leaves)
+    {
+        const FVector2D ExpectedSize = Terrain->TerrainSize / (1 << Leaf->Depth);
+        const FVector2D ExpectedCenter = Root->Center - Terrain->TerrainSize * 0.5 + FVector2D(Leaf->X + 0.5, Leaf->Y + 0.5) * ExpectedSize;
+        TestTrue(TEXT("leaf size matches its depth"), Leaf->Size.Equals(ExpectedSize, 1e-3));
+        TestTrue(TEXT("leaf center matches its grid coordinate"), Leaf->Center.Equals(ExpectedCenter, 1e-3));
+    }
+    
+    const FAccess::FNode* Deepest = FAccess::FindLeaf(*Terrain, Point);
+    TestEqual(TEXT("deepest leaf reached"), Deepest ? Deepest->Depth : -1, 10);
+    FAccess::MergeNodes(*Terrain, *Root);
+    TestEqual(TEXT("merge keeps pages"), FAccess::CountPages(*Terrain), 11);
+    FAccess::SplitToward(*Terrain, Point, 10);
+    TestTrue(TEXT("re-split reuses the same node"), FAccess::FindLeaf(*Terrain, Point) == Deepest);
+    TestEqual(TEXT("re-split allocates nothing"), FAccess::CountPages(*Terrain), 11);
+    
+    // 2:1平衡只访问当前树中的叶子，细分出的页也只在用到时分配
+    FAccess::BalanceTree(*Terrain);
+    TestTrue(TEXT("balanced tree stays sparse"), FAccess::CountPages(*Terrain) < 64);
+    return true;
+}
+
+// 并行评估每次每个叶子最多细分一级，收敛后与串行评估得到同一棵树；视点移动（含合并）后同样一致
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeTerrainParallelLodTest, "L_UnrealExample.QuadTreeTerrain.ParallelLodMatchesSerial",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeTerrainParallelLodTest::RunTest(const FString& Parameters)
+{
+    typedef FQuadTreeTerrainTestAccess FAccess;
+    FQuadTreeTestWorld TestWorld;
+    ACameraActor* Viewer = TestWorld.Spawn<ACameraActor>(FVector(120.f, -340.f, 150.f));
+    AQuadTreeTerrain* Serial = TestWorld.Spawn<AQuadTreeTerrain>(FVector::ZeroVector);
+    AQuadTreeTerrain* Parallel = TestWorld.Spawn<AQuadTreeTerrain>(FVector::ZeroVector);
+    for (AQuadTreeTerrain* Terrain : { Serial, Parallel })
+    {
+        Terrain->AdditionalViewers.Add(Viewer);
+        Terrain->bParallelLod = Terrain == Parallel;
+        Terrain->ParallelLodDepth = 2;
+        FAccess::Rebuild(*Terrain, 7);
+    }
+    
+    for (const FVector& Location : { FVector(120.f, -340.f, 150.f), FVector(-600.f, 500.f, 80.f), FVector(0.f, 0.f, 2000.f) })
+    {
+        Viewer->SetActorLocation(Location);
+        FAccess::RunLod(*Serial, Serial->MaxDepth + 2);
+        FAccess::RunLod(*Parallel, Parallel->MaxDepth + 2);
+        const TArray<FIntVector> SerialLeaves = FAccess::GetLeafKeys(*Serial);
+        TestTrue(TEXT("viewer refines the tree"), SerialLeaves.Num() > 1 || Location.Z > 1000.f);
+        TestTrue(TEXT("parallel LOD converges to the serial tree"), FAccess::GetLeafKeys(*Parallel) == SerialLeaves);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,243 @@
+﻿#include "QuadTreeTerrainTiles.h"
+#include "Async/AsyncFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Serialization/Archive.h"
+
+float FTerrainHeightTile::Sample(const FVector2D& LocalXY) const
+{
+    const float Scale = Samples - 1;
+    const float FX = FMath::Clamp((LocalXY.X - Min.X) / Size.X, 0.0, 1.0) * Scale;
+    const float FY = FMath::Clamp((LocalXY.Y - Min.Y) / Size.Y, 0.0, 1.0) * Scale;
+    const int32 X0 = FMath::Min(FMath::FloorToInt(FX), Samples - 2);
+    const int32 Y0 = FMath::Min(FMath::FloorToInt(FY), Samples - 2);
+    const float TX = FX - X0;
+    const float TY = FY - Y0;
+    const float* Row0 = Heights.GetData() + Y0 * Samples;
+    const float* Row1 = Row0 + Samples;
+    return FMath::Lerp(FMath::Lerp(Row0[X0], Row0[X0 + 1], TX), FMath::Lerp(Row1[X0], Row1[X0 + 1], TX), TY);
+}
+
+FTerrainTileStreamer::~FTerrainTileStreamer()
+{
+    Close();
+}
+
+bool FTerrainTileStreamer::WriteTileFile(const FString& Path, const FVector2D& TerrainSize, const FTerrainHeightParams& Height, int32 Levels, int32 Samples)
+{
+    TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Path));
+    if (!Writer) return false;
+    
+    // 量化范围取噪声的理论上下界（每个八度 [-1, 1] 乘振幅之和），不需要先遍历所有采样点
+    float AmplitudeSum = 0.f;
+    float Amplitude = 1.f;
+    for (int32 i = 0; i < Height.Octaves; i++)
+    {
+        AmplitudeSum += Amplitude;
+        Amplitude *= 0.5f;
+    }
+    const float HeightBound = FMath::Max(FMath::Abs(Height.HeightScale) * AmplitudeSum, KINDA_SMALL_NUMBER);
+    FTerrainTileFileHeader FileHeader;
+    FileHeader.Levels = Levels;
+    FileHeader.Samples = Samples;
+    FileHeader.TerrainSize = FVector2f(TerrainSize);
+    FileHeader.HeightMin = -HeightBound;
+    FileHeader.HeightRange = 2.f * HeightBound;
+    Writer->Serialize(&FileHeader, sizeof(FileHeader));
+    
+    // 逐块直接在最细一层网格的对应位置采样，内存中只保留一块；粗层采样点仍是细层采样点的子集
+    const FVector2D Min = -TerrainSize * 0.5f;
+    const int32 FinestSide = (1 << (Levels - 1)) * (Samples - 1) + 1;
+    const FVector2D FinestStep = TerrainSize / (FinestSide - 1);
+    TArray<uint16> Tile;
+    Tile.SetNumUninitialized(Samples * Samples);
+    for (int32 Level = 0; Level < Levels; Level++)
+    {
+        const int32 TilesPerSide = 1 << Level;
+        const int32 Stride = 1 << (Levels - 1 - Level); // 本层采样间隔（以最细一层为单位）
+        for (int32 TY = 0; TY < TilesPerSide; TY++)
+        {
+            for (int32 TX = 0; TX < TilesPerSide; TX++)
+            {
+                for (int32 Y = 0; Y < Samples; Y++)
+                {
+                    for (int32 X = 0; X < Samples; X++)
+                    {
+                        const int32 FX = (TX * (Samples - 1) + X) * Stride;
+                        const int32 FY = (TY * (Samples - 1) + Y) * Stride;
+                        const float H = Height.SampleHeight(Min + FVector2D(FX * FinestStep.X, FY * FinestStep.Y));
+                        const float Normalized = FMath::Clamp((H - FileHeader.HeightMin) / FileHeader.HeightRange, 0.f, 1.f);
+                        Tile[Y * Samples + X] = static_cast<uint16>(FMath::RoundToInt(Normalized * MAX_uint16));
+                    }
+                }
+                Writer->Serialize(Tile.GetData(), Tile.Num() * sizeof(uint16));
+            }
+        }
+    }
+    return Writer->Close();
+}
+
+bool FTerrainTileStreamer::Open(const FString& Path, int32 InResidentLevels, int32 InMaxResidentTiles)
+{
+    Close();
+    
+    TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path));
+    if (!Reader) return false;
+    Reader->Serialize(&Header, sizeof(Header));
+    const FTerrainTileFileHeader Expected;
+    if (Header.Magic != Expected.Magic || Header.Version != Expected.Version || Header.Levels <= 0 || Header.Samples < 3)
+    {
+        UE_LOG(LogTemp, Warning, TEXT("QuadTreeTerrain: invalid tile file %s"), *Path);
+        return false;
+    }
+    
+    // 常驻层同步读取
+    ResidentLevels = FMath::Clamp(InResidentLevels, 1, Header.Levels);
+    MaxResidentTiles = FMath::Max(InMaxResidentTiles, 1);
+    TArray<uint16> Data;
+    Data.SetNumUninitialized(Header.Samples * Header.Samples);
+    for (int32 Level = 0; Level < ResidentLevels; Level++)
+    {
+        for (int32 Y = 0; Y < (1 << Level); Y++)
+        {
+            for (int32 X = 0; X < (1 << Level); X++)
+            {
+                const FIntVector Key(X, Y, Level);
+                Reader->Seek(GetTileOffset(Key));
+                Reader->Serialize(Data.GetData(), Data.Num() * sizeof(uint16));
+                Tiles.Add(Key, MakeTile(Key, Data.GetData()));
+            }
+        }
+    }
+    if (Reader->IsError()) return false;
+    
+    FileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenAsyncRead(*Path);
+    return FileHandle != nullptr;
+}
+
+void FTerrainTileStreamer::Close()
+{
+    for (auto& Pair : PendingReads)
+    {
+        Pair.Value->Cancel();
+        Pair.Value->WaitCompletion();
+        delete Pair.Value;
+    }
+    PendingReads.Reset();
+    delete FileHandle;
+    FileHandle = nullptr;
+    Tiles.Reset();
+    LruOrder.Empty();
+    LruNodes.Reset();
+}
+
+FIntVector FTerrainTileStreamer::GetTileKey(const FVector2D& LocalXY, int32 Level) const
+{
+    Level = FMath::Clamp(Level, 0, Header.Levels - 1);
+    const int32 TilesPerSide = 1 << Level;
+    const FVector2D Normalized = (LocalXY + FVector2D(Header.TerrainSize) * 0.5f) / FVector2D(Header.TerrainSize);
+    return FIntVector(
+        FMath::Clamp(FMath::FloorToInt(Normalized.X * TilesPerSide), 0, TilesPerSide - 1),
+        FMath::Clamp(FMath::FloorToInt(Normalized.Y * TilesPerSide), 0, TilesPerSide - 1),
+        Level);
+}
+
+FTerrainHeightTilePtr FTerrainTileStreamer::RequestTile(const FIntVector& Key)
+{
+    if (PrefetchTile(Key))
+    {
+        return Tiles.FindChecked(Key);
+    }
+    
+    // 后备：最近的已加载祖先块，常驻层保证一定存在
+    for (FIntVector Parent(Key.X >> 1, Key.Y >> 1, Key.Z - 1); Parent.Z >= 0; Parent = FIntVector(Parent.X >> 1, Parent.Y >> 1, Parent.Z - 1))
+    {
+        if (const FTerrainHeightTilePtr* Found = Tiles.Find(Parent))
+        {
+            return *Found;
+        }
+    }
+    return nullptr;
+}
+
+bool FTerrainTileStreamer::PrefetchTile(const FIntVector& Key)
+{
+    if (Tiles.Contains(Key))
+    {
+        Touch(Key);
+        return true;
+    }
+    
+    if (FileHandle && !PendingReads.Contains(Key))
+    {
+        const int64 Bytes = Header.Samples * Header.Samples * sizeof(uint16);
+        PendingReads.Add(Key, FileHandle->ReadRequest(GetTileOffset(Key), Bytes, AIOP_Normal));
+    }
+    return false;
+}
+
+int32 FTerrainTileStreamer::Pump()
+{
+    int32 Loaded = 0;
+    for (auto It = PendingReads.CreateIterator(); It; ++It)
+    {
+        IAsyncReadRequest* Request = It.Value();
+        if (!Request->PollCompletion()) continue;
+        
+        if (uint8* Data = Request->GetReadResults())
+        {
+            Tiles.Add(It.Key(), MakeTile(It.Key(), reinterpret_cast<const uint16*>(Data)));
+            LruOrder.AddTail(It.Key());
+            LruNodes.Add(It.Key(), LruOrder.GetTail());
+            FMemory::Free(Data);
+            Loaded++;
+        }
+        delete Request;
+        It.RemoveCurrent();
+    }
+    
+    // 淘汰最久未使用的块；已交给工作线程的块由共享指针保持到任务结束
+    while (LruOrder.Num() > MaxResidentTiles)
+    {
+        FLruList::TDoubleLinkedListNode* Oldest = LruOrder.GetHead();
+        Tiles.Remove(Oldest->GetValue());
+        LruNodes.Remove(Oldest->GetValue());
+        LruOrder.RemoveNode(Oldest);
+    }
+    return Loaded;
+}
+
+int64 FTerrainTileStreamer::GetTileOffset(const FIntVector& Key) const
+{
+    // 第 L 层之前共有 (4^L - 1) / 3 块
+    const int64 TilesBefore = ((1ll << (2 * Key.Z)) - 1) / 3;
+    const int64 Index = TilesBefore + static_cast<int64>(Key.Y) * (1 << Key.Z) + Key.X;
+    return sizeof(FTerrainTileFileHeader) + Index * Header.Samples * Header.Samples * sizeof(uint16);
+}
+
+FTerrainHeightTilePtr FTerrainTileStreamer::MakeTile(const FIntVector& Key, const uint16* Data) const
+{
+    TSharedPtr<FTerrainHeightTile, ESPMode::ThreadSafe> Tile = MakeShared<FTerrainHeightTile, ESPMode::ThreadSafe>();
+    Tile->Key = Key;
+    Tile->Size = FVector2D(Header.TerrainSize) / (1 << Key.Z);
+    Tile->Min = -FVector2D(Header.TerrainSize) * 0.5f + FVector2D(Key.X, Key.Y) * Tile->Size;
+    Tile->Samples = Header.Samples;
+    Tile->Heights.SetNumUninitialized(Header.Samples * Header.Samples);
+    for (int32 i = 0; i < Tile->Heights.Num(); i++)
+    {
+        Tile->Heights[i] = Header.HeightMin + Data[i] * (Header.HeightRange / MAX_uint16);
+    }
+    return Tile;
+}
+
+void FTerrainTileStreamer::Touch(const FIntVector& Key)
+{
+    if (Key.Z < ResidentLevels) return; // 常驻层不参与淘汰
+    FLruList::TDoubleLinkedListNode* const* Node = LruNodes.Find(Key);
+    if (Node && *Node != LruOrder.GetTail())
+    {
+        // 摘下节点挂回末尾，不重新分配
+        LruOrder.RemoveNode(*Node, false);
+        LruOrder.AddTail(*Node);
+    }
+}
@@ -0,0 +1,92 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+#include "QuadTreeTerrainMesh.h"
+
+class IAsyncReadFileHandle;
+class IAsyncReadRequest;
+
+/**
+ * 分块高度场文件格式（小端）：
+ *   FTerrainTileFileHeader
+ *   第 0 层到第 Levels-1 层的所有块，层内按行存放；第 L 层有 2^L x 2^L 块
+ *   每块 Samples x Samples 个 uint16，相邻块共享边界上的采样点
+ * 粗一层的采样点是细一层采样点的子集（按点抽取），不同层的网格块在接缝处高度一致
+ */
+struct FTerrainTileFileHeader
+{
+    uint32 Magic = 0x46485451; // "QTHF"
+    uint32 Version = 1;
+    int32 Levels = 0;
+    int32 Samples = 0;
+    FVector2f TerrainSize = FVector2f::ZeroVector;
+    float HeightMin = 0.f;
+    float HeightRange = 1.f;
+};
+
+// 已加载的块，加载后只读，可在工作线程采样
+struct FTerrainHeightTile
+{
+    FIntVector Key;          // (X, Y, Level)
+    FVector2D Min;           // 覆盖范围，Actor本地坐标
+    FVector2D Size;
+    int32 Samples = 0;
+    TArray<float> Heights;
+    
+    // 双线性采样，超出范围时取边界值
+    float Sample(const FVector2D& LocalXY) const;
+};
+
+typedef TSharedPtr<const FTerrainHeightTile, ESPMode::ThreadSafe> FTerrainHeightTilePtr;
+
+/**
+ * 按需加载高度块：细分时请求，异步读取，LRU淘汰；前 ResidentLevels 层常驻，作为尚未加载时的后备
+ * 只在游戏线程调用
+ */
+class FTerrainTileStreamer
+{
+public:
+    ~FTerrainTileStreamer();
+    
+    // 由程序化高度场生成文件
+    static bool WriteTileFile(const FString& Path, const FVector2D& TerrainSize, const FTerrainHeightParams& Height, int32 Levels, int32 Samples);
+    
+    // 打开文件并同步加载常驻层
+    bool Open(const FString& Path, int32 InResidentLevels, int32 InMaxResidentTiles);
+    void Close();
+    bool IsOpen() const { return FileHandle != nullptr; }
+    
+    const FTerrainTileFileHeader& GetHeader() const { return Header; }
+    
+    // 某层覆盖某点的块
+    FIntVector GetTileKey(const FVector2D& LocalXY, int32 Level) const;
+    
+    // 返回已加载的块，未加载时发起异步读取并返回已加载的最近祖先块
+    FTerrainHeightTilePtr RequestTile(const FIntVector& Key);
+    
+    // 块已加载时刷新LRU并返回true；未加载时发起异步读取，不取祖先块
+    bool PrefetchTile(const FIntVector& Key);
+    
+    // 完成的读取转为块、按LRU淘汰超出预算的块；返回本次新加载的块数
+    int32 Pump();
+    
+private:
+    int64 GetTileOffset(const FIntVector& Key) const;
+    FTerrainHeightTilePtr MakeTile(const FIntVector& Key, const uint16* Data) const;
+    void Touch(const FIntVector& Key);
+    
+    FTerrainTileFileHeader Header;
+    IAsyncReadFileHandle* FileHandle = nullptr;
+    int32 ResidentLevels = 2;
+    int32 MaxResidentTiles = 256;
+    
+    TMap<FIntVector, FTerrainHeightTilePtr> Tiles;
+    TMap<FIntVector, IAsyncReadRequest*> PendingReads;
+    // 最近使用的在末尾，只包含可淘汰的块；LruNodes 按键找到链表节点，访问和淘汰都是 O(1)
+    typedef TDoubleLinkedList<FIntVector> FLruList;
+    FLruList LruOrder;
+    TMap<FIntVector, FLruList::TDoubleLinkedListNode*> LruNodes;
+};
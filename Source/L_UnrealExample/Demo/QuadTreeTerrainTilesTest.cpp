@@ -0,0 +1,66 @@
+﻿#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTreeTerrainTiles.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+
+// 未加载的块取常驻祖先；超出预算时淘汰最久未使用的块；不同层的块在共享采样点上高度一致
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeTerrainTilesTest, "L_UnrealExample.QuadTreeTerrain.TileStreaming",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeTerrainTilesTest::RunTest(const FString& Parameters)
+{
+    const FString Path = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("QuadTreeTerrainTilesTest.qth"));
+    const FVector2D TerrainSize(1000.f, 1000.f);
+    if (!TestTrue(TEXT("tile file written"), FTerrainTileStreamer::WriteTileFile(Path, TerrainSize, FTerrainHeightParams(), 3, 5))) return false;
+    
+    FTerrainTileStreamer Streamer;
+    if (!TestTrue(TEXT("tile file opened"), Streamer.Open(Path, 1, 2))) return false;
+    
+    // 读取是异步的，轮询直到块加载完成
+    auto WaitForTile = [&Streamer](const FIntVector& Key)
+    {
+        const double Deadline = FPlatformTime::Seconds() + 5.0;
+        while (!Streamer.PrefetchTile(Key) && FPlatformTime::Seconds() < Deadline)
+        {
+            Streamer.Pump();
+            FPlatformProcess::Sleep(0.001f);
+        }
+        return Streamer.PrefetchTile(Key);
+    };
+    
+    const FIntVector A(0, 0, 2);
+    const FIntVector B(1, 0, 2);
+    const FIntVector C(2, 0, 2);
+    FTerrainHeightTilePtr Tile = Streamer.RequestTile(A);
+    TestTrue(TEXT("unloaded tile falls back to the resident root"), Tile.IsValid() && Tile->Key.Z == 0);
+    TestTrue(TEXT("tile A loads"), WaitForTile(A));
+    Tile = Streamer.RequestTile(A);
+    TestTrue(TEXT("loaded tile returned"), Tile.IsValid() && Tile->Key == A);
+    
+    // A的角点 (-250, -250) 也是第 0 层的采样点
+    const FTerrainHeightTilePtr Root = Streamer.RequestTile(FIntVector(0, 0, 0));
+    if (Tile.IsValid() && Root.IsValid())
+    {
+        const FVector2D Corner = -TerrainSize * 0.5f + Tile->Size;
+        TestEqual(TEXT("levels agree on shared samples"), Tile->Sample(Corner), Root->Sample(Corner), 1e-3f);
+    }
+    
+    // 预算两块：B加载后再访问A，C加载时淘汰的是B
+    TestTrue(TEXT("tile B loads"), WaitForTile(B));
+    Streamer.RequestTile(A);
+    TestTrue(TEXT("tile C loads"), WaitForTile(C));
+    Tile = Streamer.RequestTile(B);
+    TestTrue(TEXT("least recently used tile evicted"), Tile.IsValid() && Tile->Key.Z == 0);
+    TestTrue(TEXT("recently used tile kept"), Streamer.PrefetchTile(A));
+    TestTrue(TEXT("newest tile kept"), Streamer.PrefetchTile(C));
+    
+    Streamer.Close();
+    IFileManager::Get().Delete(*Path);
+    return true;
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "Kismet/KismetMathLibrary.h"
 #include "DrawDebugHelpers.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "QuadTree/QuadTree.h"
 
 // Sets default values
 ABattery::ABattery()
@@ -42,3 +43,30 @@ void ABattery::ActiveState(bool _bActive, AActor* _targetActor){
 	targetActor = _targetActor;
 	GetStaticMeshComponent()->SetMaterial(0, bActive ? m_active : m_normal);
 }
+
+bool ABattery::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	if (const AQuadTree* tree = quadTree.Get())
+	{
+		bool bKnown = false;
+		const bool bRelevant = tree->IsRelevantFor(this, RealViewer, ViewTarget, bKnown);
+		if (bKnown)
+		{
+			return bRelevant || bAlwaysRelevant;
+		}
+	}
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
+
+void ABattery::SetTickThrottle(int32 _bucket, float _interval, bool _bEnable)
+{
+	significanceBucket = _bucket;
+	SetActorTickInterval(_interval);
+	SetActorTickEnabled(_bEnable);
+	UStaticMeshComponent* mesh = GetStaticMeshComponent();
+	if (mesh->PrimaryComponentTick.bCanEverTick)
+	{
+		mesh->SetComponentTickInterval(_interval);
+		mesh->SetComponentTickEnabled(_bEnable);
+	}
+}
@@ -3,15 +3,50 @@
 
 #include "QuadTree/QuadTree.h"
 
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "Algo/BinarySearch.h"
+#include "Algo/Sort.h"
+#include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
+#include "Camera/PlayerCameraManager.h"
+#include "ConvexVolume.h"
+#include "DrawDebugHelpers.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneManagement.h"
 #include "QuadTree/Battery.h"
 #include "QuadTree/QuadTreeNode.h"
+#include "Serialization/CustomVersion.h"
+#include "UObject/ObjectSaveContext.h"
+
+// AQuadTree 序列化版本
+struct FQuadTreeCustomVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+		BakedIndex,	// 烘焙索引
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FQuadTreeCustomVersion::GUID(0x5A3C1E27, 0x4B8D4F61, 0x9E02C7A4, 0x13D6B850);
+static FCustomVersionRegistration GRegisterQuadTreeCustomVersion(FQuadTreeCustomVersion::GUID, FQuadTreeCustomVersion::LatestVersion, TEXT("QuadTreeVer"));
 
 // Sets default values
 AQuadTree::AQuadTree()
 {
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
+
+	// 默认分档：近处每帧 Tick，中距离降频，远处关闭 Tick
+	significanceBuckets.Add(FQuadTreeSignificanceBucket(200, 0, false));
+	significanceBuckets.Add(FQuadTreeSignificanceBucket(600, 0.2f, false));
+	significanceBuckets.Add(FQuadTreeSignificanceBucket(MAX_flt, 0, true));
 }
 
 UObject* QuadTreeNode::worldObject=nullptr;
@@ -21,25 +56,123 @@ void AQuadTree::BeginPlay()
 {
 	Super::BeginPlay();
 	QuadTreeNode::worldObject = GetWorld();
-	root = MakeShareable(new QuadTreeNode(FVector::ZeroVector, FVector(height, width, 0), 0));
+	tuneState = FQuadTreeTuneState();
+	if (bUseStreamingCells)
+	{
+		// 流式单元模式：关卡加载时挂接其对象所在的单元，卸载时摘除
+		levelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &AQuadTree::OnLevelAdded);
+		levelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &AQuadTree::OnLevelRemoved);
+		for (ULevel* level : GetWorld()->GetLevels())
+		{
+			if (level->bIsVisible)
+			{
+				OnLevelAdded(level, GetWorld());
+			}
+		}
+	}
+	else if (!RestoreBakedIndex())
+	{
+		root = MakeRootNode(FVector::ZeroVector, FVector(height, width, 0));
+		for (ABattery* obj : bakedObjs)
+		{
+			// 烘焙结果失效时逐个插入预先放置的电池
+			if (IsValid(obj))
+			{
+				RegisterObj(obj);
+				InsertIntoIndex(obj);
+			}
+		}
+	}
+	velocityEpoch = 0;
+	if (scenario)
+	{
+		// 场景模式：位置一次性确定（优先使用烘焙结果），之后按场景的速率生成
+		scenario->GetSpawnTransforms(FVector2D(height, width), scenarioTransforms);
+		scenarioSpawnIndex = 0;
+		if (scenario->spawnInterval > 0)
+		{
+			GetWorld()->GetTimerManager().SetTimer(timer, this, &AQuadTree::SpawnActors, scenario->spawnInterval, true);
+		}
+		else
+		{
+			while (scenarioSpawnIndex < scenarioTransforms.Num())
+			{
+				SpawnActors();
+			}
+		}
+		GetWorld()->GetTimerManager().SetTimer(timer2, this, &AQuadTree::ActorsAddVelocity, scenario->velocityInterval, true);
+		return;
+	}
 	GetWorld()->GetTimerManager().SetTimer(timer, this, &AQuadTree::SpawnActors, playRate, true);
 	GetWorld()->GetTimerManager().SetTimer(timer2, this, &AQuadTree::ActorsAddVelocity, 2, true);
 }
 
+void AQuadTree::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(levelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(levelRemovedHandle);
+	cells.Empty();
+	levelEntries.Empty();
+	root.Reset(); //子节点不再反向持有根节点，整棵树在这里释放
+	{
+		FScopeLock lock(&snapshotLock);
+		publishedSnapshot.Reset();
+	}
+	snapshotBuffers[0].Reset();
+	snapshotBuffers[1].Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void AQuadTree::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	if (root.IsValid())
-	{			
-		root->UpdateState(); //更新状态
-		root->TraceObjectInRange(traceActor, affectRadianRange); //判断是否在扫描器的范围内	
+	if (root.IsValid() || bUseStreamingCells)
+	{
+		FlushPendingInserts(); //同步点：提交其他线程暂存的插入
+		RetryOrphans();
+		const double startTime = FPlatformTime::Seconds();
+		UpdateIndex(); //更新状态
+		TraceIndex(); //判断是否在扫描器的范围内	
+		if (tuneMode != EQuadTreeTuneMode::Off)
+		{
+			TuneStep(FPlatformTime::Seconds() - startTime);
+		}
+		UpdateSignificance();
+		if (bUseInterestManagement)
+		{
+			TArray<FQuadTreeViewer> viewers;
+			GatherViewers(viewers);
+			UpdateRelevancy(viewers);
+		}
+		if (bPublishSnapshot)
+		{
+			PublishSnapshot(); //发布本帧的只读快照
+		}
 	}
 }
 
 // 定时生成物体
 void AQuadTree::SpawnActors()
 {
+	if (scenario)
+	{
+		const int32 last = scenario->spawnInterval > 0 ? FMath::Min(scenarioSpawnIndex + scenario->spawnPerTick, scenarioTransforms.Num()) : scenarioTransforms.Num();
+		for (; scenarioSpawnIndex < last; scenarioSpawnIndex++)
+		{
+			ABattery* actor = GetWorld()->SpawnActor<ABattery>(BatteryClass, scenarioTransforms[scenarioSpawnIndex]);
+			if (IsValid(actor))
+			{
+				RegisterObj(actor);
+				InsertIntoIndex(actor);
+			}
+		}
+		if (scenarioSpawnIndex >= scenarioTransforms.Num())
+		{
+			GetWorld()->GetTimerManager().ClearTimer(timer);
+		}
+		return;
+	}
 	if (cubeCount < 0) {
 		GetWorld()->GetTimerManager().ClearTimer(timer);
 		return;
@@ -52,16 +185,996 @@ void AQuadTree::SpawnActors()
 	ABattery* actor= GetWorld()->SpawnActor<ABattery>(BatteryClass, trans);
 	if (IsValid(actor))
 	{
-		objs.Add(actor);
-		root->InsertObj(actor);
+		RegisterObj(actor);
+		InsertIntoIndex(actor);
 	}
 }
 
 // 定时给物体一个速度
 void AQuadTree::ActorsAddVelocity()
 {
+	kineticEpoch++; //速度改变后旧的截止时间不再成立
+	if (scenario)
+	{
+		// 场景模式：速度只取决于种子、对象句柄和第几次改变
+		objMaxSpeed = scenario->speedSchedule.Num() > 0 ? scenario->speedSchedule[velocityEpoch % scenario->speedSchedule.Num()] : scenario->speed;
+		for (ABattery* actor :objs)
+		{
+			if (IsValid(actor))
+				actor->GetStaticMeshComponent()->SetPhysicsLinearVelocity(scenario->GetVelocity(actor->quadTreeHandle, velocityEpoch));
+		}
+		velocityEpoch++;
+		return;
+	}
+	objMaxSpeed = 50;
 	for (ABattery* actor :objs)
 	{
-		actor->GetStaticMeshComponent()->SetPhysicsLinearVelocity(UKismetMathLibrary::RandomUnitVector() * 50);
+		if (IsValid(actor))
+			actor->GetStaticMeshComponent()->SetPhysicsLinearVelocity(UKismetMathLibrary::RandomUnitVector() * 50);
+	}
+}
+
+// 线程安全的插入入口：只写暂存队列，不触碰树结构，游戏线程的查询不受影响
+void AQuadTree::QueueInsert(ABattery* obj)
+{
+	if (obj)
+	{
+		pendingInserts.Enqueue(obj);
+	}
+}
+
+// 同步点：批量提交暂存对象，超出预算的留到下一帧
+void AQuadTree::FlushPendingInserts()
+{
+	check(IsInGameThread());
+	int32 committed = 0;
+	TWeakObjectPtr<ABattery> pending;
+	while ((maxInsertsPerFrame <= 0 || committed < maxInsertsPerFrame) && pendingInserts.Dequeue(pending))
+	{
+		ABattery* actor = pending.Get();
+		if (!IsValid(actor) || !actor->GetLevel()->bIsVisible) //所属关卡已在等待期间卸载
+			continue;
+		RegisterObj(actor);
+		InsertIntoIndex(actor);
+		committed++;
+	}
+}
+
+// 在后台缓冲构建快照后交换发布，读线程始终看到完整的一帧
+void AQuadTree::PublishSnapshot()
+{
+	LLM_SCOPE_BYTAG(QuadTree);
+	TSharedPtr<FQuadTreeSnapshot, ESPMode::ThreadSafe>& back = snapshotBuffers[snapshotBackIndex];
+	// 后台缓冲已不再被发布，若仍有读线程持有则不能复用，重新分配一份
+	if (!back.IsValid() || !back.IsUnique())
+	{
+		back = MakeShared<FQuadTreeSnapshot, ESPMode::ThreadSafe>();
+	}
+	TArray<TPair<FIntPoint, const QuadTreeNode*>> roots;
+	if (bUseStreamingCells)
+	{
+		for (const auto& pair : cells)
+		{
+			roots.Emplace(pair.Key, pair.Value.root.Get());
+		}
+	}
+	else
+	{
+		roots.Emplace(FIntPoint::ZeroValue, root.Get());
+	}
+	back->Build(roots, bUseStreamingCells ? cellSize : 0, GFrameCounter);
+	{
+		FScopeLock lock(&snapshotLock);
+		publishedSnapshot = back;
+	}
+	snapshotBackIndex ^= 1;
+}
+
+FQuadTreeSnapshotPtr AQuadTree::GetSnapshot() const
+{
+	FScopeLock lock(&snapshotLock);
+	return publishedSnapshot;
+}
+
+void AQuadTree::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+	Ar.UsingCustomVersion(FQuadTreeCustomVersion::GUID);
+	if (Ar.CustomVer(FQuadTreeCustomVersion::GUID) >= FQuadTreeCustomVersion::BakedIndex)
+	{
+		Ar << bakedConfigHash;
+		bakedNodes.BulkSerialize(Ar);
+	}
+}
+
+#if WITH_EDITOR
+void AQuadTree::PreSave(FObjectPreSaveContext ObjectSaveContext)
+{
+	Super::PreSave(ObjectSaveContext);
+	BakeIndex();
+}
+#endif
+
+// 用与运行时相同的配置和插入顺序构建，再展开为扁平数组
+void AQuadTree::BakeIndex()
+{
+	bakedNodes.Reset();
+	bakedObjs.Reset();
+	bakedConfigHash = 0;
+	ULevel* level = GetLevel();
+	if (!bBakeIndex || bUseStreamingCells || !level)
+		return;
+
+	TSharedPtr<QuadTreeNode> bakeRoot = MakeRootNode(FVector::ZeroVector, FVector(height, width, 0));
+	int32 count = 0;
+	for (AActor* actor : level->Actors)
+	{
+		ABattery* obj = Cast<ABattery>(actor);
+		if (IsValid(obj) && bakeRoot->InterSection(obj->GetActorLocation()))
+		{
+			bakeRoot->InsertObj(obj);
+			count++;
+		}
+	}
+	if (count == 0)
+		return;
+	bakeRoot->Flatten(bakedNodes, bakedObjs);
+	bakedConfigHash = GetBakeConfigHash();
+}
+
+// 校验通过后整棵树一次建好；位置已经偏离所在叶子的对象（例如被其他 BeginPlay 移动）单独重新插入
+bool AQuadTree::RestoreBakedIndex()
+{
+	if (!bBakeIndex || bakedNodes.Num() == 0 || bakedConfigHash != GetBakeConfigHash())
+		return false;
+
+	// 结构校验：子节点在父节点之后，对象只在叶子中，区间不越界且互不重叠，每个对象恰好出现一次
+	// 除根外每个节点恰好有一个父节点；父节点下标总小于子节点，所以这也保证了所有节点都能从根到达
+	int32 objTotal = 0;
+	TBitArray<> objCovered(false, bakedObjs.Num());
+	TArray<int32> parentCount;
+	parentCount.Init(0, bakedNodes.Num());
+	for (int32 i = 0; i < bakedNodes.Num(); i++)
+	{
+		const FQuadTreeBakedNode& node = bakedNodes[i];
+		if (node.firstObj < 0 || node.objCount < 0 || node.firstObj + node.objCount > bakedObjs.Num())
+			return false;
+		if (!node.isLeaf && node.objCount)
+			return false;
+		for (int32 k = node.firstObj; k < node.firstObj + node.objCount; k++)
+		{
+			if (objCovered[k])
+				return false;
+			objCovered[k] = true;
+		}
+		objTotal += node.objCount;
+		for (int32 childIndex : node.child)
+		{
+			if (childIndex == INDEX_NONE)
+				continue;
+			if (childIndex <= i || childIndex >= bakedNodes.Num() || ++parentCount[childIndex] > 1)
+				return false;
+		}
+	}
+	if (objTotal != bakedObjs.Num())
+		return false;
+	for (int32 i = 1; i < bakedNodes.Num(); i++)
+	{
+		if (parentCount[i] != 1)
+			return false;
+	}
+
+	// 已失效的对象和离开所在叶子的对象在重建时直接跳过，之后只重新插入移动过的对象
+	TBitArray<> skip(false, bakedObjs.Num());
+	TArray<ABattery*> moved;
+	for (const FQuadTreeBakedNode& node : bakedNodes)
+	{
+		const FVector pMin = FVector(node.center - node.extend);
+		const FVector pMax = FVector(node.center + node.extend);
+		for (int32 i = node.firstObj; i < node.firstObj + node.objCount; i++)
+		{
+			ABattery* obj = bakedObjs[i];
+			if (!IsValid(obj))
+			{
+				skip[i] = true;
+				continue;
+			}
+			const FVector location = obj->GetActorLocation();
+			if (location.X < pMin.X || location.X > pMax.X || location.Y < pMin.Y || location.Y > pMax.Y)
+			{
+				skip[i] = true;
+				moved.Add(obj);
+			}
+		}
+	}
+
+	root = QuadTreeNode::Restore(bakedNodes, bakedObjs, skip, leafCapacity, maxDepth);
+	if (!root.IsValid())
+		return false;
+	for (ABattery* obj : bakedObjs)
+	{
+		if (IsValid(obj))
+		{
+			RegisterObj(obj);
+		}
+	}
+	for (ABattery* obj : moved)
+	{
+		InsertIntoIndex(obj);
+	}
+	return true;
+}
+
+uint32 AQuadTree::GetBakeConfigHash() const
+{
+	uint32 hash = GetTypeHash(leafCapacity);
+	hash = HashCombineFast(hash, GetTypeHash(maxDepth));
+	hash = HashCombineFast(hash, GetTypeHash(width));
+	hash = HashCombineFast(hash, GetTypeHash(height));
+	return hash;
+}
+
+TSharedPtr<QuadTreeNode> AQuadTree::MakeRootNode(FVector _center, FVector _extend) const
+{
+	LLM_SCOPE_BYTAG(QuadTree);
+	TSharedPtr<QuadTreeNode> node = MakeShareable(new QuadTreeNode(_center, _extend, 0));
+	node->maxCount = leafCapacity;
+	node->maxDepth = maxDepth;
+	return node;
+}
+
+// 以新的配置重建整棵树，对象的激活状态保存在对象自身，不受影响
+void AQuadTree::RebuildTree(int32 _capacity, int32 _depth)
+{
+	leafCapacity = FMath::Max(1, _capacity);
+	maxDepth = FMath::Max(1, _depth);
+	auto rebuild = [this](TSharedPtr<QuadTreeNode>& subtree)
+	{
+		TArray<ABattery*> all;
+		subtree->CollectObjs(all);
+		subtree = MakeRootNode(subtree->center, subtree->extend);
+		for (ABattery* obj : all)
+		{
+			subtree->InsertObj(obj);
+		}
+	};
+	if (root.IsValid())
+	{
+		rebuild(root);
+	}
+	for (auto& pair : cells)
+	{
+		rebuild(pair.Value.root);
+	}
+
+	FQuadTreeMemoryStats memory;
+	GetIndexMemory(memory);
+	UE_LOG(LogTemp, Log, TEXT("QuadTree rebuilt (capacity %d, depth %d): %d nodes, %.1f KB (slack %.1f KB)"),
+		leafCapacity, maxDepth, memory.nodeCount, memory.GetTotal() / 1024.0, memory.slackBytes / 1024.0);
+}
+
+// 坐标下降：每个窗口测一个配置（容量翻倍/减半、深度加减一），没有更优的邻居时结束
+void AQuadTree::TuneStep(double frameSeconds)
+{
+	FQuadTreeTuneState& state = tuneState;
+	if (state.bDone)
+		return;
+
+	if (state.bestCost < 0 && state.frames == 0 && state.tried.Num() == 0)
+	{
+		state.original = FIntPoint(leafCapacity, maxDepth);
+		state.tried.Add(state.original);
+	}
+
+	state.frames++;
+	state.seconds += frameSeconds;
+	state.objFrames += objs.Num() - freeHandles.Num();
+	if (state.frames < tuneWindowFrames)
+		return;
+
+	// 窗口结束：汇总统计，计算当前配置每对象每帧的耗时
+	FQuadTreeStats stats;
+	CollectIndexStats(stats, true);
+	const FIntPoint current(leafCapacity, maxDepth);
+	const double cost = state.seconds / FMath::Max<int64>(state.objFrames, 1);
+	const double visitsPerFrame = double(stats.visitCount) / state.frames;
+	const double reinsertRate = double(stats.reinsertCount) / FMath::Max<int64>(state.objFrames, 1);
+	UE_LOG(LogTemp, Log, TEXT("QuadTree tune: capacity=%d depth=%d cost=%.3fus/obj nodes=%d leaves=%d depth=%d visits=%.1f/frame reinsert=%.4f/obj"),
+		current.X, current.Y, cost * 1e6, stats.nodeCount, stats.leafCount, stats.depth, visitsPerFrame, reinsertRate);
+	state.frames = 0;
+	state.seconds = 0;
+	state.objFrames = 0;
+
+	const bool bImproved = state.bestCost < 0 || cost < state.bestCost * 0.95;
+	if (bImproved)
+	{
+		state.best = current;
+		state.bestCost = cost;
+
+		// 以当前最优配置为中心生成邻居；重插入频繁说明叶子太小，优先尝试更大容量/更浅的树
+		TArray<FIntPoint> neighbors = {
+			FIntPoint(current.X * 2, current.Y),
+			FIntPoint(current.X, current.Y - 1),
+			FIntPoint(FMath::Max(1, current.X / 2), current.Y),
+			FIntPoint(current.X, current.Y + 1),
+		};
+		if (reinsertRate < 0.01)
+		{
+			Swap(neighbors[0], neighbors[2]);
+			Swap(neighbors[1], neighbors[3]);
+		}
+		state.candidates.Reset();
+		for (const FIntPoint& n : neighbors)
+		{
+			if (n.X >= 1 && n.X <= 256 && n.Y >= 1 && n.Y <= 16 && !state.tried.Contains(n))
+			{
+				state.candidates.Add(n);
+			}
+		}
+	}
+
+	if (state.candidates.Num() > 0)
+	{
+		const FIntPoint next = state.candidates[0];
+		state.candidates.RemoveAt(0);
+		state.tried.Add(next);
+		RebuildTree(next.X, next.Y);
+		return;
+	}
+
+	// 没有更优的邻居，调优结束
+	state.bDone = true;
+	const FIntPoint apply = tuneMode == EQuadTreeTuneMode::AutoApply ? state.best : state.original;
+	UE_LOG(LogTemp, Log, TEXT("QuadTree tune: best capacity=%d depth=%d (%.3fus/obj), %s"),
+		state.best.X, state.best.Y, state.bestCost * 1e6,
+		tuneMode == EQuadTreeTuneMode::AutoApply ? TEXT("applied") : TEXT("recommended, keeping original"));
+	if (apply != current)
+	{
+		RebuildTree(apply.X, apply.Y);
+	}
+}
+
+void AQuadTree::InsertIntoIndex(ABattery* obj)
+{
+	const FVector location = obj->GetActorLocation();
+	if (!bUseStreamingCells)
+	{
+		if (root->InterSection(location))
+			root->InsertObj(obj);
+		else
+			orphans.Add(obj); //在固定区域外，回到区域内后再插入
+		return;
+	}
+
+	const FIntPoint coord = GetCellCoord(location);
+	FQuadTreeCell* cell = cells.Find(coord);
+	// 常驻关卡不会被卸载，其对象所在的单元按需挂接
+	if (!cell && obj->GetLevel() == GetWorld()->PersistentLevel)
+	{
+		cell = &AttachCell(coord, obj->GetLevel());
+	}
+	if (!cell)
+	{
+		orphans.Add(obj); //所在单元尚未加载
+		return;
+	}
+	cell->root->InsertObj(obj);
+	if (!cell->levels.Contains(obj->GetLevel()))
+	{
+		AddForeignObj(*cell, coord, obj);
+	}
+}
+
+void AQuadTree::UpdateIndex()
+{
+	TArray<ABattery*> escaped;
+	if (!bUseStreamingCells)
+	{
+		root->UpdateState(escaped);
+		orphans.Append(escaped);
+		return;
+	}
+
+	for (auto& pair : cells)
+	{
+		const int32 first = escaped.Num();
+		pair.Value.root->UpdateState(escaped);
+		for (int32 i = first; i < escaped.Num(); i++)
+		{
+			RemoveForeignObj(pair.Value, escaped[i]);
+		}
+	}
+	// 离开单元的对象按网格重新分配到所在单元
+	for (ABattery* obj : escaped)
+	{
+		InsertIntoIndex(obj);
+	}
+}
+
+void AQuadTree::QueryFrustum(const FConvexVolume& frustum, TArray<ABattery*>& outObjs) const
+{
+	if (!bUseStreamingCells)
+	{
+		if (root.IsValid())
+		{
+			root->QueryFrustum(frustum, frustumHalfHeight, frustumObjRadius, outObjs);
+		}
+	}
+	else
+	{
+		for (const auto& pair : cells)
+		{
+			if (pair.Value.root.IsValid())
+			{
+				pair.Value.root->QueryFrustum(frustum, frustumHalfHeight, frustumObjRadius, outObjs);
+			}
+		}
+	}
+	// 孤儿对象不在任何子树中，逐个检测
+	for (ABattery* obj : orphans)
+	{
+		if (IsValid(obj) && frustum.IntersectSphere(obj->GetActorLocation(), frustumObjRadius))
+		{
+			outObjs.Add(obj);
+		}
+	}
+}
+
+bool AQuadTree::QueryPlayerCameraFrustum(const APlayerController* player, TArray<ABattery*>& outObjs) const
+{
+	if (!player || !player->PlayerCameraManager)
+		return false;
+
+	FMinimalViewInfo view = player->PlayerCameraManager->GetCameraCacheView();
+	if (!view.bConstrainAspectRatio)
+	{
+		// 使用视口实际的宽高比
+		int32 sizeX = 0, sizeY = 0;
+		player->GetViewportSize(sizeX, sizeY);
+		if (sizeX > 0 && sizeY > 0)
+		{
+			view.AspectRatio = (float)sizeX / sizeY;
+			view.bConstrainAspectRatio = true;
+		}
+	}
+	FMatrix viewMatrix, projectionMatrix, viewProjectionMatrix;
+	UGameplayStatics::GetViewProjectionMatrix(view, viewMatrix, projectionMatrix, viewProjectionMatrix);
+
+	FConvexVolume frustum;
+	GetViewFrustumBounds(frustum, viewProjectionMatrix, true);
+	QueryFrustum(frustum, outObjs);
+	return true;
+}
+
+void AQuadTree::TraceIndex()
+{
+	inRangeObjs.Reset();
+	if (!traceActor)
+	{
+		ApplyRangeTransitions(); //没有扫描器，全部离开范围
+		return;
+	}
+	FQuadTreeKineticParams kinetic;
+	const FQuadTreeKineticParams* kineticPtr = nullptr;
+	if (bKineticScheduling)
+	{
+		kinetic = MakeKineticParams();
+		kineticPtr = &kinetic;
+	}
+	if (!bUseStreamingCells)
+	{
+		root->TraceObjectInRange(traceActor->GetActorLocation(), affectRadianRange, inRangeObjs, kineticPtr);
+		ApplyRangeTransitions();
+		return;
+	}
+
+	// 粗粒度网格路由：只检测与扫描范围相交的单元，上一帧相交而本帧不相交的单元做一次移出处理
+	const FVector center = traceActor->GetActorLocation();
+	const FIntPoint minCell = GetCellCoord(center - FVector(affectRadianRange));
+	const FIntPoint maxCell = GetCellCoord(center + FVector(affectRadianRange));
+	TSet<FIntPoint> traced;
+	for (int32 y = minCell.Y; y <= maxCell.Y; y++)
+	{
+		for (int32 x = minCell.X; x <= maxCell.X; x++)
+		{
+			if (FQuadTreeCell* cell = cells.Find(FIntPoint(x, y)))
+			{
+				cell->root->TraceObjectInRange(center, affectRadianRange, inRangeObjs, kineticPtr);
+				traced.Add(FIntPoint(x, y));
+			}
+		}
+	}
+	for (const FIntPoint& coord : tracedCells)
+	{
+		FQuadTreeCell* cell = cells.Find(coord);
+		if (cell && !traced.Contains(coord))
+		{
+			cell->root->TraceObjectOutRange(center, affectRadianRange);
+		}
+	}
+	tracedCells = MoveTemp(traced);
+	ApplyRangeTransitions();
+}
+
+FQuadTreeKineticParams AQuadTree::MakeKineticParams()
+{
+	FQuadTreeKineticParams params;
+	params.now = GetWorld()->GetTimeSeconds();
+	const FVector scanner = traceActor->GetActorLocation();
+	const double elapsed = params.now - lastKineticTime;
+	// 扫描器瞬移或半径变化都会破坏截止时间的前提
+	if (lastScannerRadius != affectRadianRange ||
+		FVector::DistSquaredXY(scanner, lastScannerLocation) > FMath::Square(scannerMaxSpeed * elapsed) + KINDA_SMALL_NUMBER)
+	{
+		kineticEpoch++;
+	}
+	lastScannerLocation = scanner;
+	lastScannerRadius = affectRadianRange;
+	lastKineticTime = params.now;
+	params.closingSpeed = objMaxSpeed * kineticSpeedMargin + scannerMaxSpeed;
+	params.epoch = kineticEpoch;
+	return params;
+}
+
+// 两个有序数组归并：只在本帧出现的为进入，只在上一帧出现的为离开，状态未变的对象不会被访问
+void AQuadTree::ApplyRangeTransitions()
+{
+	activeObjs.RemoveAll([](ABattery* obj) { return !IsValid(obj); }); //已被销毁的对象
+	Algo::Sort(inRangeObjs);
+	enteredObjs.Reset();
+	exitedObjs.Reset();
+
+	int32 i = 0, j = 0;
+	while (i < activeObjs.Num() || j < inRangeObjs.Num())
+	{
+		if (j >= inRangeObjs.Num() || (i < activeObjs.Num() && activeObjs[i] < inRangeObjs[j]))
+		{
+			exitedObjs.Add(activeObjs[i++]);
+		}
+		else if (i >= activeObjs.Num() || inRangeObjs[j] < activeObjs[i])
+		{
+			enteredObjs.Add(inRangeObjs[j++]);
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+	Swap(activeObjs, inRangeObjs);
+
+	for (ABattery* obj : exitedObjs)
+	{
+		obj->ActiveState(false, nullptr);
+	}
+	for (ABattery* obj : enteredObjs)
+	{
+		obj->ActiveState(true, traceActor);
+	}
+	if (exitedObjs.Num() > 0)
+	{
+		exitRangeEvent.Broadcast(exitedObjs);
+	}
+	if (enteredObjs.Num() > 0)
+	{
+		enterRangeEvent.Broadcast(enteredObjs);
+	}
+}
+
+void AQuadTree::GatherViewers(TArray<FQuadTreeViewer>& outViewers) const
+{
+	// 只有服务器需要为连接的玩家计算相关性
+	if (GetNetMode() == NM_ListenServer || GetNetMode() == NM_DedicatedServer)
+	{
+		for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it)
+		{
+			APlayerController* player = it->Get();
+			if (!player)
+				continue;
+			FQuadTreeViewer& viewer = outViewers.AddDefaulted_GetRef();
+			FRotator rotation;
+			player->GetPlayerViewPoint(viewer.location, rotation);
+			viewer.viewActor = player;
+			viewer.cullRadius = netCullRadius;
+		}
+	}
+	for (const FQuadTreeViewer& simulated : simulatedViewers)
+	{
+		FQuadTreeViewer& viewer = outViewers.Add_GetRef(simulated);
+		if (simulated.viewActor)
+		{
+			viewer.location = simulated.viewActor->GetActorLocation();
+			viewer.viewActor = nullptr; // 模拟观察者不参与 IsNetRelevantFor
+		}
+	}
+}
+
+// 每 64 个观察者一组共享一次遍历，结果与上次的集合做有序归并得到增量
+void AQuadTree::UpdateRelevancy(const TArray<FQuadTreeViewer>& viewers)
+{
+	TArray<FQuadTreeViewerRelevancy> previous = MoveTemp(viewerRelevancy);
+	viewerRelevancy.Reset();
+	viewerRelevancy.SetNum(viewers.Num());
+
+	TArray<FVector2f> centers;
+	TArray<float> radii;
+	centers.Reserve(viewers.Num());
+	radii.Reserve(viewers.Num());
+	for (int32 v = 0; v < viewers.Num(); v++)
+	{
+		centers.Add(FVector2f(viewers[v].location.X, viewers[v].location.Y));
+		radii.Add(viewers[v].cullRadius);
+		viewerRelevancy[v].viewer = viewers[v].viewActor;
+		// 玩家观察者按对象匹配上次的结果，模拟观察者按下标匹配
+		const int32 prev = viewers[v].viewActor
+			? previous.IndexOfByPredicate([&](const FQuadTreeViewerRelevancy& r) { return r.viewer == viewers[v].viewActor; })
+			: (previous.IsValidIndex(v) && previous[v].viewer == nullptr ? v : INDEX_NONE);
+		if (prev != INDEX_NONE)
+		{
+			// 借用上次的数组内存，relevant 在下面整体替换
+			Swap(viewerRelevancy[v].added, previous[prev].relevant);
+		}
+	}
+
+	TArray<TArray<ABattery*>> current;
+	current.SetNum(viewers.Num());
+	for (int32 base = 0; base < viewers.Num(); base += 64)
+	{
+		const int32 count = FMath::Min(64, viewers.Num() - base);
+		const uint64 mask = count == 64 ? MAX_uint64 : ((1ull << count) - 1);
+		const TArrayView<const FVector2f> centerView(centers.GetData() + base, count);
+		const TArrayView<const float> radiusView(radii.GetData() + base, count);
+		const TArrayView<TArray<ABattery*>> outView(current.GetData() + base, count);
+		if (root.IsValid())
+		{
+			root->QueryViewers(centerView, radiusView, mask, outView);
+		}
+		for (const auto& pair : cells)
+		{
+			if (pair.Value.root.IsValid())
+			{
+				pair.Value.root->QueryViewers(centerView, radiusView, mask, outView);
+			}
+		}
+	}
+	// 孤儿对象不在任何子树中
+	for (ABattery* obj : orphans)
+	{
+		if (!IsValid(obj))
+			continue;
+		const FVector location = obj->GetActorLocation();
+		for (int32 v = 0; v < viewers.Num(); v++)
+		{
+			if (FVector2f::DistSquared(centers[v], FVector2f(location.X, location.Y)) <= radii[v] * radii[v])
+			{
+				current[v].Add(obj);
+			}
+		}
+	}
+
+	for (int32 v = 0; v < viewers.Num(); v++)
+	{
+		FQuadTreeViewerRelevancy& state = viewerRelevancy[v];
+		TArray<ABattery*> last = MoveTemp(state.added);
+		state.added.Reset();
+		state.relevant = MoveTemp(current[v]);
+		Algo::Sort(state.relevant);
+		int32 i = 0, j = 0;
+		while (i < last.Num() || j < state.relevant.Num())
+		{
+			if (j >= state.relevant.Num() || (i < last.Num() && last[i] < state.relevant[j]))
+			{
+				state.removed.Add(last[i++]);
+			}
+			else if (i >= last.Num() || state.relevant[j] < last[i])
+			{
+				state.added.Add(state.relevant[j++]);
+			}
+			else
+			{
+				i++;
+				j++;
+			}
+		}
+
+		if (bDrawViewers)
+		{
+			const FVector location(centers[v].X, centers[v].Y, 11);
+			DrawDebugCircle(GetWorld(), location, radii[v], 48, FColor::Yellow, false, -1, 0, 2, FVector(0, 1, 0), FVector(1, 0, 0), false);
+			DrawDebugString(GetWorld(), location + FVector(0, 0, 40),
+				FString::Printf(TEXT("%d (+%d -%d)"), state.relevant.Num(), state.added.Num(), state.removed.Num()), nullptr, FColor::Yellow, 0, true);
+		}
+	}
+}
+
+bool AQuadTree::IsRelevantFor(const ABattery* obj, const AActor* realViewer, const AActor* viewTarget, bool& bOutKnown) const
+{
+	bOutKnown = false;
+	if (!bUseInterestManagement)
+		return false;
+	for (const FQuadTreeViewerRelevancy& state : viewerRelevancy)
+	{
+		if (state.viewer && (state.viewer == realViewer || state.viewer == viewTarget))
+		{
+			bOutKnown = true;
+			return Algo::BinarySearch(state.relevant, const_cast<ABattery*>(obj)) != INDEX_NONE;
+		}
+	}
+	return false;
+}
+
+void AQuadTree::CollectIndexStats(FQuadTreeStats& stats, bool bReset)
+{
+	if (root.IsValid())
+	{
+		root->CollectStats(stats, bReset);
 	}
-}
\ No newline at end of file
+	for (auto& pair : cells)
+	{
+		pair.Value.root->CollectStats(stats, bReset);
+	}
+}
+
+FIntPoint AQuadTree::GetCellCoord(const FVector& location) const
+{
+	return FIntPoint(FMath::FloorToInt(location.X / cellSize), FMath::FloorToInt(location.Y / cellSize));
+}
+
+FQuadTreeCell& AQuadTree::AttachCell(FIntPoint coord, ULevel* owner)
+{
+	FQuadTreeCell& cell = cells.FindOrAdd(coord);
+	if (!cell.root.IsValid())
+	{
+		const FVector extend(cellSize * 0.5f, cellSize * 0.5f, 0);
+		cell.root = MakeRootNode(FVector(coord.X * cellSize, coord.Y * cellSize, 0) + extend, extend);
+	}
+	if (owner && !cell.levels.Contains(owner))
+	{
+		cell.levels.Add(owner);
+		levelEntries.FindOrAdd(owner).cells.Add(coord);
+	}
+	return cell;
+}
+
+// 整棵子树随单元一起摘除；移入本单元的外来对象仍然存活，放回孤儿列表等待重新分配
+void AQuadTree::DetachCell(FIntPoint coord)
+{
+	FQuadTreeCell cell;
+	if (!cells.RemoveAndCopyValue(coord, cell))
+		return;
+	for (ABattery* obj : cell.foreignObjs)
+	{
+		if (FQuadTreeLevelEntry* entry = levelEntries.Find(obj->GetLevel()))
+		{
+			entry->foreignObjs.Remove(obj);
+		}
+		orphans.Add(obj);
+	}
+	tracedCells.Remove(coord);
+}
+
+void AQuadTree::AddForeignObj(FQuadTreeCell& cell, FIntPoint coord, ABattery* obj)
+{
+	cell.foreignObjs.Add(obj);
+	levelEntries.FindOrAdd(obj->GetLevel()).foreignObjs.Add(obj, coord);
+}
+
+void AQuadTree::RemoveForeignObj(FQuadTreeCell& cell, ABattery* obj)
+{
+	if (cell.foreignObjs.Remove(obj) == 0)
+		return;
+	if (FQuadTreeLevelEntry* entry = levelEntries.Find(obj->GetLevel()))
+	{
+		entry->foreignObjs.Remove(obj);
+	}
+}
+
+void AQuadTree::RetryOrphans()
+{
+	if (orphans.Num() == 0)
+		return;
+	TArray<ABattery*> pending = MoveTemp(orphans);
+	orphans.Reset();
+	for (ABattery* obj : pending)
+	{
+		if (IsValid(obj))
+		{
+			InsertIntoIndex(obj);
+		}
+	}
+}
+
+// 关卡加载：挂接其对象所在的单元，对象经暂存队列分摊到后续帧插入
+void AQuadTree::OnLevelAdded(ULevel* level, UWorld* world)
+{
+	if (!level || world != GetWorld())
+		return;
+	for (AActor* actor : level->Actors)
+	{
+		ABattery* battery = Cast<ABattery>(actor);
+		if (IsValid(battery))
+		{
+			AttachCell(GetCellCoord(battery->GetActorLocation()), level);
+			QueueInsert(battery);
+		}
+	}
+}
+
+// 关卡卸载：只访问该关卡登记的单元和对象。只属于该关卡的单元整棵摘除；
+// 移动到其他单元的对象、以及与其他关卡共享的单元中的对象，沿所在位置的路径逐个移除
+void AQuadTree::OnLevelRemoved(ULevel* level, UWorld* world)
+{
+	if (world != GetWorld())
+		return;
+	if (!level) //整个世界被清理
+	{
+		cells.Empty();
+		levelEntries.Empty();
+		tracedCells.Empty();
+		orphans.Empty();
+		return;
+	}
+
+	FQuadTreeLevelEntry entry;
+	if (levelEntries.RemoveAndCopyValue(level, entry))
+	{
+		for (const auto& pair : entry.foreignObjs)
+		{
+			if (FQuadTreeCell* cell = cells.Find(pair.Value))
+			{
+				cell->foreignObjs.Remove(pair.Key);
+				cell->root->RemoveObjAt(pair.Key, pair.Key->GetActorLocation());
+			}
+		}
+
+		TSet<FIntPoint> shared;
+		for (const FIntPoint& coord : entry.cells)
+		{
+			FQuadTreeCell* cell = cells.Find(coord);
+			if (!cell || cell->levels.Remove(level) == 0)
+				continue;
+			if (cell->levels.Num() == 0)
+			{
+				DetachCell(coord);
+			}
+			else
+			{
+				shared.Add(coord); //单元由多个关卡共享（少见）
+			}
+		}
+		for (ABattery* obj : entry.objs)
+		{
+			if (shared.Num() > 0 && !entry.foreignObjs.Contains(obj))
+			{
+				const FVector location = obj->GetActorLocation();
+				const FIntPoint coord = GetCellCoord(location);
+				if (shared.Contains(coord))
+				{
+					cells[coord].root->RemoveObjAt(obj, location);
+				}
+			}
+			UnregisterObj(obj);
+		}
+	}
+
+	orphans.RemoveAllSwap([level](ABattery* obj) { return !IsValid(obj) || obj->GetLevel() == level; });
+}
+
+// 对象表：句柄即下标，释放的句柄回收复用，保证已发布快照中的句柄在对象存活期间稳定
+uint32 AQuadTree::RegisterObj(ABattery* obj)
+{
+	if (obj->quadTreeHandle != MAX_uint32)
+		return obj->quadTreeHandle;
+	obj->quadTree = this;
+	if (bUseStreamingCells)
+	{
+		levelEntries.FindOrAdd(obj->GetLevel()).objs.Add(obj);
+	}
+	if (freeHandles.Num() > 0)
+	{
+		obj->quadTreeHandle = freeHandles.Pop(false);
+		objs[obj->quadTreeHandle] = obj;
+	}
+	else
+	{
+		obj->quadTreeHandle = objs.Add(obj);
+	}
+	return obj->quadTreeHandle;
+}
+
+void AQuadTree::UnregisterObj(ABattery* obj)
+{
+	const uint32 handle = obj->quadTreeHandle;
+	if (handle == MAX_uint32 || !objs.IsValidIndex(handle) || objs[handle] != obj)
+		return;
+	objs[handle] = nullptr;
+	freeHandles.Add(handle);
+	if (FQuadTreeLevelEntry* entry = levelEntries.Find(obj->GetLevel()))
+	{
+		entry->objs.Remove(obj);
+	}
+	obj->quadTree = nullptr;
+	obj->quadTreeHandle = MAX_uint32;
+}
+
+ABattery* AQuadTree::ResolveHandle(uint32 handle) const
+{
+	return objs.IsValidIndex(handle) ? objs[handle] : nullptr;
+}
+
+// 索引内存：实时树之外，已发布快照每个对象只占 8 字节，节点 24 字节
+SIZE_T AQuadTree::GetSnapshotMemory() const
+{
+	FQuadTreeSnapshotPtr snapshot = GetSnapshot();
+	return snapshot.IsValid() ? snapshot->GetAllocatedSize() : 0;
+}
+
+void AQuadTree::GetIndexMemory(FQuadTreeMemoryStats& stats) const
+{
+	if (root.IsValid())
+	{
+		root->CollectMemory(stats);
+	}
+	for (const auto& pair : cells)
+	{
+		if (pair.Value.root.IsValid())
+		{
+			pair.Value.root->CollectMemory(stats);
+		}
+		stats.tableBytes += pair.Value.levels.GetAllocatedSize() + pair.Value.foreignObjs.GetAllocatedSize();
+	}
+	for (const auto& pair : levelEntries)
+	{
+		stats.tableBytes += pair.Value.cells.GetAllocatedSize() + pair.Value.objs.GetAllocatedSize() + pair.Value.foreignObjs.GetAllocatedSize();
+	}
+	stats.tableBytes += levelEntries.GetAllocatedSize();
+	stats.tableBytes += objs.GetAllocatedSize() + freeHandles.GetAllocatedSize() + orphans.GetAllocatedSize() + cells.GetAllocatedSize() + tracedCells.GetAllocatedSize();
+	stats.slackBytes += objs.GetSlack() * sizeof(ABattery*) + freeHandles.GetSlack() * sizeof(uint32);
+	for (const auto& buffer : snapshotBuffers)
+	{
+		if (buffer.IsValid())
+		{
+			stats.snapshotBytes += sizeof(FQuadTreeSnapshot) + buffer->GetAllocatedSize();
+		}
+	}
+}
+
+void AQuadTree::UpdateSignificance()
+{
+	if (!bThrottleTicks || significanceBuckets.Num() == 0)
+		return;
+
+	TArray<FVector> sources;
+	for (AActor* source : significanceSources)
+	{
+		if (IsValid(source))
+		{
+			sources.Add(source->GetActorLocation());
+		}
+	}
+	if (sources.Num() == 0 && traceActor)
+	{
+		sources.Add(traceActor->GetActorLocation());
+	}
+	if (sources.Num() == 0)
+		return;
+
+	TArray<float> distances;
+	for (const FQuadTreeSignificanceBucket& bucket : significanceBuckets)
+	{
+		distances.Add(bucket.maxDistance);
+	}
+	auto applyBucket = [this](ABattery* obj, int32 bucket)
+	{
+		const FQuadTreeSignificanceBucket& setting = significanceBuckets[bucket];
+		obj->SetTickThrottle(bucket, setting.tickInterval, !setting.bDisableTick);
+	};
+	if (root.IsValid())
+	{
+		root->UpdateSignificance(sources, distances, applyBucket);
+	}
+	for (auto& pair : cells)
+	{
+		pair.Value.root->UpdateSignificance(sources, distances, applyBucket);
+	}
+}
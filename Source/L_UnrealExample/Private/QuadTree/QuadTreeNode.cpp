@@ -4,8 +4,15 @@
 #include "Kismet/KismetMathLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "QuadTree/Battery.h"
+#include "ConvexVolume.h"
+#include "QuadTree/QuadTreeSimd.h"
 
-QuadTreeNode::QuadTreeNode(FVector _center, FVector _extend, int32 _depth, TSharedPtr<QuadTreeNode> _root)
+// 叶子检测的位掩码缓冲，容量足够时不分配堆内存
+typedef TArray<uint32, TInlineAllocator<8>> FQuadTreeHitMask;
+
+LLM_DEFINE_TAG(QuadTree);
+
+QuadTreeNode::QuadTreeNode(FVector _center, FVector _extend, int32 _depth, QuadTreeNode* _root)
 	: center(_center), extend(_extend), depth(_depth)
 {
 	root = _root;
@@ -18,6 +25,8 @@ QuadTreeNode::~QuadTreeNode()
 {
 	root = nullptr;
 	objs.Empty();
+	posX.Empty();
+	posY.Empty();
 	child_node.Empty();
 }
 
@@ -54,8 +63,14 @@ bool QuadTreeNode::InterSection(FVector _pMin, FVector _pMax, FVector _point)
 //插入对象
 void QuadTreeNode::InsertObj(ABattery* obj)
 {
+	LLM_SCOPE_BYTAG(QuadTree);
+	const FVector location = obj->GetActorLocation();
 	objs.Add(obj);
-	if (isLeaf && objs.Num() <= maxCount) //直接插入			
+	posX.Add(location.X);
+	posY.Add(location.Y);
+	bSignificanceDirty = true;
+	kineticDeadline = 0; //新对象不受原截止时间的约束，插入路径上的节点都需要重新检测
+	if (isLeaf && (objs.Num() <= maxCount || depth >= maxDepth)) //直接插入，达到最大深度后不再细分
 	{				
 		return;
 	}	
@@ -64,25 +79,30 @@ void QuadTreeNode::InsertObj(ABattery* obj)
 	float dy[4] = { 1, 1, -1, -1 };
 	//超过上限个数，创建子节点;或者不再是叶子节点
 	isLeaf = false;
-	for (auto& item : objs) {
+	for (int32 k = 0; k < objs.Num(); k++) {
+		ABattery* item = objs[k];
+		const FVector itemLocation(posX[k], posY[k], 0);
 		for (int i = 0; i < 4; i++)
 		{
 			//四个象限
 			FVector p = center + FVector(extend.X * dx[i], extend.Y * dy[i], 0);
 			FVector pMin = p.ComponentMin(center);
 			FVector pMax = p.ComponentMax(center);
-			if (InterSection(pMin, pMax, item->GetActorLocation())) {
+			if (InterSection(pMin, pMax, itemLocation)) {
 				if (!child_node[i].IsValid())
 				{
-					root = root.IsValid() ? root : this->AsShared();
-					child_node[i] = MakeShareable(new QuadTreeNode(pMin/2+pMax/2, extend / 2, depth + 1, root));
+					child_node[i] = MakeShareable(new QuadTreeNode(pMin/2+pMax/2, extend / 2, depth + 1, root ? root : this));
+					child_node[i]->maxCount = maxCount;
+					child_node[i]->maxDepth = maxDepth;
 				}
 				child_node[i]->InsertObj(item);
-				//break; //确保只在一个象限内
+				break; //确保只在一个象限内，避免边界上的对象被重复插入
 			}
 		}
 	}
 	objs.Empty(); //确保非叶子节点不存
+	posX.Empty();
+	posY.Empty();
 }
 
 // 绘制区域边界
@@ -96,42 +116,50 @@ void QuadTreeNode::DrawBound(float time, float thickness)
 	}
 }
 
-// 判断电池是否在扫描器的范围类
-void QuadTreeNode::TraceObjectInRange(AActor* traceActor, float _radian)
+// 判断电池是否在扫描器的范围类，范围内的对象放入 outInRange，状态切换由 AQuadTree 统一处理
+void QuadTreeNode::TraceObjectInRange(FVector _OCenter, float _radian, TArray<ABattery*>& outInRange, const FQuadTreeKineticParams* kinetic)
 {
-	FVector _OCenter = traceActor->GetActorLocation();
+	if (kinetic && kinetic->epoch == kineticEpoch && kinetic->now < kineticDeadline)
+		return; //截止时间之前不可能进入范围，上次检测时范围标记已经清除
+	visitCount++;
 	if (InterSection(_OCenter, _radian)) {
 		bInRange = true;
 		if (isLeaf) {
-			for (ABattery* obj : objs)
-			{					
-				_OCenter.Z = obj->GetActorLocation().Z;
-				bool bCanActive = FVector::Distance(_OCenter, obj->GetActorLocation()) <= _radian;
-				obj->ActiveState(bCanActive, traceActor);
-			}
+			// 批量检测整个叶子：平方距离比较，不再逐个读取位置和开方
+			FQuadTreeHitMask mask;
+			mask.SetNumUninitialized(QuadTreeSimd::MaskWords(objs.Num()));
+			QuadTreeSimd::TestCircle(posX.GetData(), posY.GetData(), objs.Num(), _OCenter.X, _OCenter.Y, _radian, mask.GetData());
+			QuadTreeSimd::ForEachHit(mask.GetData(), objs.Num(), [this, &outInRange](int32 i) { outInRange.Add(objs[i]); });
 		}
 		else {
 			for (auto& node : child_node)
 			{
 				if (node.IsValid()) {
-					node->TraceObjectInRange(traceActor, _radian);
+					node->TraceObjectInRange(_OCenter, _radian, outInRange, kinetic);
 				}
 			}
 		}
 	}
 	else {
 		TraceObjectOutRange(_OCenter, _radian);
+		if (kinetic && kinetic->closingSpeed > 0)
+		{
+			// 子树中的对象都在节点包围盒内，到圆的距离不小于包围盒到圆的距离，以相对速度上限接近
+			const double dx = FMath::Max(FMath::Abs(_OCenter.X - center.X) - extend.X, 0.0);
+			const double dy = FMath::Max(FMath::Abs(_OCenter.Y - center.Y) - extend.Y, 0.0);
+			const double gap = FMath::Sqrt(dx * dx + dy * dy) - _radian;
+			kineticDeadline = kinetic->now + gap / kinetic->closingSpeed;
+			kineticEpoch = kinetic->epoch;
+		}
 	}
 }
 
+// 只清除节点的范围标记；父节点不在范围内时子树标记已全部清除，直接返回
 void QuadTreeNode::TraceObjectOutRange(FVector _OCenter, float _radian)
 {
+	if (!bInRange)
+		return;
 	bInRange = false;
-	for (ABattery* obj : objs){
-		{				
-			obj->ActiveState(false, nullptr);
-		}
-	}
 	for (auto& node: child_node)
 	{
 
@@ -142,7 +170,7 @@ void QuadTreeNode::TraceObjectOutRange(FVector _OCenter, float _radian)
 }
 
 // 更新状态
-void QuadTreeNode::UpdateState()
+void QuadTreeNode::UpdateState(TArray<ABattery*>& outEscaped)
 {
 		DrawBound(1 / UKismetSystemLibrary::GetFrameCount()); //根据帧数绘制
 
@@ -150,7 +178,7 @@ void QuadTreeNode::UpdateState()
 			for (auto& node : child_node){
 				if (node.IsValid())
 				{
-					node->UpdateState();
+					node->UpdateState(outEscaped);
 					if (node->IsNotUsed())
 					{
 						node.Reset();
@@ -171,17 +199,336 @@ void QuadTreeNode::UpdateState()
 		}
 		
 		if (isLeaf && objs.Num()>0){ //如果叶子节点，更新物体是否在区域内；不在区域则移出，并重新插入
+			QuadTreeNode* treeRoot = root ? root : this;
 			int32 i = 0;
 			while (i<objs.Num())
 			{
-				if (!InterSection(objs[i]->GetActorLocation())) {	
+				const FVector location = objs[i]->GetActorLocation();
+				if (!InterSection(location)) {	
 					ABattery* battery = objs[i];
-					objs.Swap(i, objs.Num() - 1);
-					objs.Pop();
-					root->InsertObj(battery);
+					RemoveAtSwap(i);
+					reinsertCount++;
+					if (treeRoot != this && treeRoot->InterSection(location))
+						treeRoot->InsertObj(battery);
+					else
+						outEscaped.Add(battery); //离开了整棵树的范围
 					continue;
 				}
+				posX[i] = location.X;
+				posY[i] = location.Y;
 				i++;
 			}
 		}
-	}
\ No newline at end of file
+	}
+
+// 收集子树中的所有对象
+void QuadTreeNode::CollectObjs(TArray<ABattery*>& outObjs) const
+{
+	outObjs.Append(objs);
+	for (const auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->CollectObjs(outObjs);
+		}
+	}
+}
+
+// 多观察者查询：每个节点只访问一次，与节点不相交的观察者从掩码中去掉，掩码为 0 时整棵子树跳过
+void QuadTreeNode::QueryViewers(TArrayView<const FVector2f> centers, TArrayView<const float> radii, uint64 viewerMask, TArrayView<TArray<ABattery*>> outPerViewer) const
+{
+	uint64 mask = viewerMask;
+	for (uint64 bits = viewerMask; bits; bits &= bits - 1)
+	{
+		const int32 v = FMath::CountTrailingZeros64(bits);
+		const float dx = FMath::Max(FMath::Abs(centers[v].X - center.X) - extend.X, 0.0);
+		const float dy = FMath::Max(FMath::Abs(centers[v].Y - center.Y) - extend.Y, 0.0);
+		if (dx * dx + dy * dy > radii[v] * radii[v])
+		{
+			mask &= ~(1ull << v);
+		}
+	}
+	if (!mask)
+		return;
+	if (isLeaf)
+	{
+		FQuadTreeHitMask hits;
+		hits.SetNumUninitialized(QuadTreeSimd::MaskWords(objs.Num()));
+		for (uint64 bits = mask; bits; bits &= bits - 1)
+		{
+			const int32 v = FMath::CountTrailingZeros64(bits);
+			QuadTreeSimd::TestCircle(posX.GetData(), posY.GetData(), objs.Num(), centers[v].X, centers[v].Y, radii[v], hits.GetData());
+			TArray<ABattery*>& out = outPerViewer[v];
+			QuadTreeSimd::ForEachHit(hits.GetData(), objs.Num(), [this, &out](int32 i) { out.Add(objs[i]); });
+		}
+		return;
+	}
+	for (const auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->QueryViewers(centers, radii, mask, outPerViewer);
+		}
+	}
+}
+
+// 矩形查询
+void QuadTreeNode::QueryBox(const FVector2f& _pMin, const FVector2f& _pMax, TArray<ABattery*>& outObjs) const
+{
+	if (center.X + extend.X < _pMin.X || center.X - extend.X > _pMax.X ||
+		center.Y + extend.Y < _pMin.Y || center.Y - extend.Y > _pMax.Y)
+		return;
+	if (isLeaf)
+	{
+		FQuadTreeHitMask mask;
+		mask.SetNumUninitialized(QuadTreeSimd::MaskWords(objs.Num()));
+		QuadTreeSimd::TestBox(posX.GetData(), posY.GetData(), objs.Num(), _pMin, _pMax, mask.GetData());
+		QuadTreeSimd::ForEachHit(mask.GetData(), objs.Num(), [this, &outObjs](int32 i) { outObjs.Add(objs[i]); });
+		return;
+	}
+	for (const auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->QueryBox(_pMin, _pMax, outObjs);
+		}
+	}
+}
+
+// 视锥查询
+void QuadTreeNode::QueryFrustum(const FConvexVolume& frustum, float halfHeight, float objRadius, TArray<ABattery*>& outObjs) const
+{
+	bool bFullyContained = false;
+	// 对象可能压在节点边界上，包围盒按对象半径放大
+	const FVector boxExtend(extend.X + objRadius, extend.Y + objRadius, halfHeight + objRadius);
+	if (!frustum.IntersectBox(center, boxExtend, bFullyContained))
+		return;
+	if (bFullyContained)
+	{
+		CollectObjs(outObjs); //整棵子树都在视锥内，不再逐个检测
+		return;
+	}
+	if (isLeaf)
+	{
+		for (ABattery* obj : objs)
+		{
+			if (obj && frustum.IntersectSphere(obj->GetActorLocation(), objRadius))
+			{
+				outObjs.Add(obj);
+			}
+		}
+		return;
+	}
+	for (const auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->QueryFrustum(frustum, halfHeight, objRadius, outObjs);
+		}
+	}
+}
+
+// 汇总统计信息
+void QuadTreeNode::CollectStats(FQuadTreeStats& stats, bool bReset)
+{
+	stats.nodeCount++;
+	stats.leafCount += isLeaf ? 1 : 0;
+	stats.objCount += objs.Num();
+	stats.depth = FMath::Max(stats.depth, depth);
+	stats.visitCount += visitCount;
+	stats.reinsertCount += reinsertCount;
+	if (bReset)
+	{
+		visitCount = 0;
+		reinsertCount = 0;
+	}
+	for (auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->CollectStats(stats, bReset);
+		}
+	}
+}
+
+// 汇总子树占用的内存；节点由 MakeShareable 分配，另有一个独立的引用计数控制块
+// 控制块是 TReferenceControllerWithDeleter：引用计数基类加上指向对象的指针（默认删除器是空类，不占空间）。
+// 不计分配器的对齐与头部开销，结果是实际占用的下限
+void QuadTreeNode::CollectMemory(FQuadTreeMemoryStats& stats) const
+{
+	static constexpr SIZE_T controllerBytes = sizeof(SharedPointerInternals::TReferenceControllerBase<ESPMode::ThreadSafe>) + sizeof(QuadTreeNode*);
+	stats.nodeCount++;
+	stats.nodeBytes += sizeof(QuadTreeNode) + controllerBytes + child_node.GetAllocatedSize();
+	stats.objListBytes += objs.GetAllocatedSize() + posX.GetAllocatedSize() + posY.GetAllocatedSize();
+	stats.slackBytes += objs.GetSlack() * sizeof(ABattery*) + (posX.GetSlack() + posY.GetSlack()) * sizeof(float);
+	for (const auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->CollectMemory(stats);
+		}
+	}
+}
+
+// 从子树中移除对象
+int32 QuadTreeNode::RemoveObj(ABattery* obj)
+{
+	int32 removed = 0;
+	const int32 index = objs.Find(obj);
+	if (index != INDEX_NONE)
+	{
+		RemoveAtSwap(index);
+		removed++;
+	}
+	for (auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			removed += node->RemoveObj(obj);
+		}
+	}
+	return removed;
+}
+
+// 与 InsertObj 相同的象限顺序向下查找，边界上的对象会落到插入时的同一个叶子
+int32 QuadTreeNode::RemoveObjAt(ABattery* obj, const FVector& location)
+{
+	QuadTreeNode* node = this;
+	while (!node->isLeaf)
+	{
+		QuadTreeNode* next = nullptr;
+		for (auto& child : node->child_node)
+		{
+			if (child.IsValid() && child->InterSection(location))
+			{
+				next = child.Get();
+				break;
+			}
+		}
+		if (!next)
+			break;
+		node = next;
+	}
+	const int32 index = node->objs.Find(obj);
+	if (index != INDEX_NONE)
+	{
+		node->RemoveAtSwap(index);
+		return 1;
+	}
+	return RemoveObj(obj);
+}
+
+// 更新重要度分档：子节点离扫描器不会比父节点近，父节点已在最远档且无新对象时跳过整棵子树
+void QuadTreeNode::UpdateSignificance(const TArray<FVector>& sources, const TArray<float>& bucketDistances, TFunctionRef<void(ABattery*, int32)> applyBucket)
+{
+	float distance = MAX_flt;
+	for (const FVector& source : sources)
+	{
+		const float dx = FMath::Max(FMath::Abs(source.X - center.X) - extend.X, 0.0);
+		const float dy = FMath::Max(FMath::Abs(source.Y - center.Y) - extend.Y, 0.0);
+		distance = FMath::Min(distance, FMath::Sqrt(dx * dx + dy * dy));
+	}
+	const int32 lastBucket = bucketDistances.Num() - 1;
+	int32 bucket = lastBucket;
+	for (int32 i = 0; i < bucketDistances.Num(); i++)
+	{
+		if (distance <= bucketDistances[i])
+		{
+			bucket = i;
+			break;
+		}
+	}
+
+	const bool bChanged = bucket != significance || bSignificanceDirty;
+	significance = bucket;
+	bSignificanceDirty = false;
+	if (isLeaf)
+	{
+		if (bChanged)
+		{
+			for (ABattery* obj : objs)
+			{
+				if (obj->significanceBucket != bucket)
+				{
+					applyBucket(obj, bucket);
+				}
+			}
+		}
+		return;
+	}
+	if (!bChanged && bucket == lastBucket)
+		return;
+	for (auto& node : child_node)
+	{
+		if (node.IsValid())
+		{
+			node->UpdateSignificance(sources, bucketDistances, applyBucket);
+		}
+	}
+}
+
+// 先序展开，子节点下标总是大于父节点
+int32 QuadTreeNode::Flatten(TArray<FQuadTreeBakedNode>& outNodes, TArray<ABattery*>& outObjs) const
+{
+	const int32 index = outNodes.AddZeroed();
+	{
+		FQuadTreeBakedNode& baked = outNodes[index];
+		baked.center = FVector3f(center);
+		baked.extend = FVector3f(extend);
+		baked.firstObj = outObjs.Num();
+		baked.objCount = objs.Num();
+		baked.depth = depth;
+		baked.isLeaf = isLeaf ? 1 : 0;
+	}
+	outObjs.Append(objs);
+	for (int32 i = 0; i < 4; i++)
+	{
+		// 递归会使数组重新分配，不能持有引用
+		const int32 childIndex = child_node[i].IsValid() ? child_node[i]->Flatten(outNodes, outObjs) : INDEX_NONE;
+		outNodes[index].child[i] = childIndex;
+	}
+	return index;
+}
+
+TSharedPtr<QuadTreeNode> QuadTreeNode::Restore(const TArray<FQuadTreeBakedNode>& nodes, const TArray<ABattery*>& objs, const TBitArray<>& skipObjs, int32 _maxCount, int32 _maxDepth)
+{
+	LLM_SCOPE_BYTAG(QuadTree);
+	TArray<TSharedPtr<QuadTreeNode>> restored;
+	restored.SetNum(nodes.Num());
+	for (int32 i = 0; i < nodes.Num(); i++)
+	{
+		const FQuadTreeBakedNode& baked = nodes[i];
+		// 先序存放，父节点已经创建；根节点 i==0
+		TSharedPtr<QuadTreeNode>& node = restored[i];
+		if (!node.IsValid())
+		{
+			node = MakeShareable(new QuadTreeNode(FVector(baked.center), FVector(baked.extend), baked.depth, i > 0 ? restored[0].Get() : nullptr));
+		}
+		node->isLeaf = baked.isLeaf != 0;
+		node->maxCount = _maxCount;
+		node->maxDepth = _maxDepth;
+		node->objs.Reserve(baked.objCount);
+		node->posX.Reserve(baked.objCount);
+		node->posY.Reserve(baked.objCount);
+		for (int32 k = baked.firstObj; k < baked.firstObj + baked.objCount; k++)
+		{
+			if (skipObjs[k])
+				continue;
+			const FVector location = objs[k]->GetActorLocation();
+			node->objs.Add(objs[k]);
+			node->posX.Add(location.X);
+			node->posY.Add(location.Y);
+		}
+		for (int32 c = 0; c < 4; c++)
+		{
+			const int32 childIndex = baked.child[c];
+			if (childIndex != INDEX_NONE)
+			{
+				const FQuadTreeBakedNode& child = nodes[childIndex];
+				restored[childIndex] = MakeShareable(new QuadTreeNode(FVector(child.center), FVector(child.extend), child.depth, restored[0].Get()));
+				node->child_node[c] = restored[childIndex];
+			}
+		}
+	}
+	return restored.Num() > 0 ? restored[0] : nullptr;
+}
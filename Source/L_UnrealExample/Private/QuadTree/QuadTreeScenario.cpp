@@ -0,0 +1,146 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "QuadTree/QuadTreeScenario.h"
+
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+
+// Box-Muller，FRandomStream 没有正态分布
+static FVector2D RandNormal2D(const FRandomStream& stream)
+{
+	const float u1 = FMath::Max(stream.GetFraction(), UE_SMALL_NUMBER);
+	const float u2 = stream.GetFraction();
+	const float r = FMath::Sqrt(-2.0f * FMath::Loge(u1));
+	return FVector2D(r * FMath::Cos(2 * PI * u2), r * FMath::Sin(2 * PI * u2));
+}
+
+void UQuadTreeScenario::GetSpawnTransforms(const FVector2D& halfExtent, TArray<FTransform>& outTransforms) const
+{
+	if (IsBakeValid(halfExtent))
+	{
+		outTransforms = bakedTransforms;
+		return;
+	}
+	GenerateSpawnTransforms(halfExtent, outTransforms);
+}
+
+void UQuadTreeScenario::GenerateSpawnTransforms(const FVector2D& halfExtent, TArray<FTransform>& outTransforms) const
+{
+	FRandomStream stream(seed);
+	const FVector2D range(FMath::Max(halfExtent.X - edgeMargin, 0.0), FMath::Max(halfExtent.Y - edgeMargin, 0.0));
+
+	TArray<FVector2D> clusterCenters;
+	if (distribution == EQuadTreeSpawnDistribution::Clustered)
+	{
+		for (int32 i = 0; i < clusterCount; i++)
+		{
+			clusterCenters.Add(FVector2D(stream.FRandRange(-range.X, range.X), stream.FRandRange(-range.Y, range.Y)));
+		}
+	}
+	const int32 gridSide = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt((float)spawnCount)));
+	const FVector2D gridStep = range * 2 / gridSide;
+
+	outTransforms.Reset(spawnCount);
+	for (int32 i = 0; i < spawnCount; i++)
+	{
+		FVector2D p;
+		switch (distribution)
+		{
+		case EQuadTreeSpawnDistribution::Clustered:
+			p = clusterCenters[stream.RandHelper(clusterCenters.Num())] + RandNormal2D(stream) * clusterRadius;
+			break;
+		case EQuadTreeSpawnDistribution::Grid:
+			p = -range + FVector2D(i % gridSide + stream.GetFraction(), i / gridSide + stream.GetFraction()) * gridStep;
+			break;
+		default:
+			p = FVector2D(stream.FRandRange(-range.X, range.X), stream.FRandRange(-range.Y, range.Y));
+			break;
+		}
+		p.X = FMath::Clamp(p.X, -range.X, range.X);
+		p.Y = FMath::Clamp(p.Y, -range.Y, range.Y);
+		const float yaw = stream.FRandRange(0, 360);
+		outTransforms.Add(FTransform(FRotator(0, yaw, 0), FVector(p.X, p.Y, spawnHeight), FVector(0.2)));
+	}
+}
+
+void UQuadTreeScenario::Bake(const FVector2D& halfExtent)
+{
+	GenerateSpawnTransforms(halfExtent, bakedTransforms);
+	bakedHash = GetSettingsHash(halfExtent);
+}
+
+bool UQuadTreeScenario::IsBakeValid(const FVector2D& halfExtent) const
+{
+	return bakedTransforms.Num() == spawnCount && bakedHash == GetSettingsHash(halfExtent);
+}
+
+FVector UQuadTreeScenario::GetVelocity(uint32 handle, int32 epoch) const
+{
+	// 每个对象每次独立取随机数，对象生成顺序或数量变化不影响其他对象
+	const FRandomStream stream(HashCombineFast(HashCombineFast(GetTypeHash(seed), handle), GetTypeHash(epoch)));
+	const float currentSpeed = speedSchedule.Num() > 0 ? speedSchedule[epoch % speedSchedule.Num()] : speed;
+	return stream.GetUnitVector() * currentSpeed;
+}
+
+uint32 UQuadTreeScenario::GetSettingsHash(const FVector2D& halfExtent) const
+{
+	uint32 hash = GetTypeHash(seed);
+	hash = HashCombineFast(hash, GetTypeHash(spawnCount));
+	hash = HashCombineFast(hash, GetTypeHash((uint8)distribution));
+	hash = HashCombineFast(hash, GetTypeHash(clusterCount));
+	hash = HashCombineFast(hash, GetTypeHash(clusterRadius));
+	hash = HashCombineFast(hash, GetTypeHash(edgeMargin));
+	hash = HashCombineFast(hash, GetTypeHash(spawnHeight));
+	hash = HashCombineFast(hash, GetTypeHash(halfExtent));
+	return hash;
+}
+
+UQuadTreeScenarioCommandlet::UQuadTreeScenarioCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UQuadTreeScenarioCommandlet::Main(const FString& Params)
+{
+	FString scenarioPath;
+	if (!FParse::Value(*Params, TEXT("Scenario="), scenarioPath))
+	{
+		UE_LOG(LogTemp, Error, TEXT("QuadTreeScenario: usage -run=QuadTreeScenario -Scenario=/Game/Path/Asset [-Width=500] [-Height=500]"));
+		return 1;
+	}
+	int32 width = 500, height = 500;
+	FParse::Value(*Params, TEXT("Width="), width);
+	FParse::Value(*Params, TEXT("Height="), height);
+
+	UQuadTreeScenario* scenario = LoadObject<UQuadTreeScenario>(nullptr, *scenarioPath);
+	if (!scenario)
+	{
+		UE_LOG(LogTemp, Error, TEXT("QuadTreeScenario: failed to load %s"), *scenarioPath);
+		return 1;
+	}
+
+	// 与 AQuadTree 的区域一致：X 方向为 height，Y 方向为 width
+	const double startTime = FPlatformTime::Seconds();
+	scenario->Bake(FVector2D(height, width));
+	UE_LOG(LogTemp, Display, TEXT("QuadTreeScenario: baked %d transforms in %.2f ms"),
+		scenario->bakedTransforms.Num(), (FPlatformTime::Seconds() - startTime) * 1000);
+
+#if WITH_EDITOR
+	UPackage* package = scenario->GetOutermost();
+	package->MarkPackageDirty();
+	const FString fileName = FPackageName::LongPackageNameToFilename(package->GetName(), FPackageName::GetAssetPackageExtension());
+	FSavePackageArgs saveArgs;
+	saveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	if (!UPackage::SavePackage(package, scenario, *fileName, saveArgs))
+	{
+		UE_LOG(LogTemp, Error, TEXT("QuadTreeScenario: failed to save %s"), *fileName);
+		return 1;
+	}
+#endif
+	return 0;
+}
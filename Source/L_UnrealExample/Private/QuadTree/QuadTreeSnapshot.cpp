@@ -0,0 +1,172 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuadTree/QuadTreeSnapshot.h"
+#include "QuadTree/Battery.h"
+#include "QuadTree/QuadTreeNode.h"
+
+//方形与圆形求交，与 QuadTreeNode::InterSection 相同
+static bool BoxIntersectCircle(const FVector2f& center, const FVector2f& extend, const FVector2f& _OCenter, float _radian)
+{
+	const FVector2f v = _OCenter - center;
+	const float x = FMath::Clamp(v.X, -extend.X, extend.X);
+	const float y = FMath::Clamp(v.Y, -extend.Y, extend.Y);
+	return (x - v.X) * (x - v.X) + (y - v.Y) * (y - v.Y) <= _radian * _radian;
+}
+
+// 相对包围盒最小角量化到 [0, 65535]
+static uint16 Quantize(double value, float boxMin, float boxSize)
+{
+	const double t = boxSize > 0 ? (value - boxMin) / boxSize : 0;
+	return (uint16)FMath::Clamp<int32>(FMath::RoundToInt32(t * MAX_uint16), 0, MAX_uint16);
+}
+
+void FQuadTreeSnapshot::Build(const TArray<TPair<FIntPoint, const QuadTreeNode*>>& roots, float _cellSize, uint64 _frameNumber)
+{
+	frameNumber = _frameNumber;
+	cellSize = _cellSize;
+	rootCount = roots.Num();
+	nodes.Reset();
+	packedObjs.Reset();
+	cellRoots.Reset();
+	buildQueue.Reset();
+
+	// 广度优先展开，根节点在最前面，同一父节点的子节点连续
+	for (const TPair<FIntPoint, const QuadTreeNode*>& pair : roots)
+	{
+		cellRoots.Add(pair.Key, buildQueue.Num());
+		buildQueue.Add(pair.Value);
+	}
+	nodes.AddZeroed(rootCount);
+	for (int32 i = 0; i < buildQueue.Num(); i++)
+	{
+		const QuadTreeNode* src = buildQueue[i];
+		FQuadTreeSnapshotNode& node = nodes[i];
+		node.center = FVector2f(src->center.X, src->center.Y);
+		node.extend = FVector2f(src->extend.X, src->extend.Y);
+
+		if (src->isLeaf)
+		{
+			node.isLeaf = 1;
+			node.first = packedObjs.Num();
+			node.count = src->objs.Num();
+			const float minX = node.center.X - node.extend.X;
+			const float minY = node.center.Y - node.extend.Y;
+			for (int32 k = 0; k < src->objs.Num(); k++)
+			{
+				// 叶子中已有本帧 UpdateState 刷新的坐标
+				FQuadTreePackedObj& packed = packedObjs.AddDefaulted_GetRef();
+				packed.x = Quantize(src->posX[k], minX, 2 * node.extend.X);
+				packed.y = Quantize(src->posY[k], minY, 2 * node.extend.Y);
+				packed.handle = src->objs[k]->quadTreeHandle;
+			}
+			continue;
+		}
+
+		const int32 first = nodes.Num();
+		for (const TSharedPtr<QuadTreeNode>& child : src->child_node)
+		{
+			if (child.IsValid())
+			{
+				buildQueue.Add(child.Get());
+			}
+		}
+		nodes.AddZeroed(buildQueue.Num() - first);
+		nodes[i].first = first;
+		nodes[i].count = buildQueue.Num() - first;
+	}
+	buildQueue.Reset(); // 不保留指向实时节点的指针
+}
+
+void FQuadTreeSnapshot::GatherRoots(const FVector& _pMin, const FVector& _pMax, FNodeStack& stack) const
+{
+	if (cellSize <= 0)
+	{
+		for (int32 i = 0; i < rootCount; i++)
+		{
+			stack.Add(i);
+		}
+		return;
+	}
+
+	const FIntPoint minCell(FMath::FloorToInt(_pMin.X / cellSize), FMath::FloorToInt(_pMin.Y / cellSize));
+	const FIntPoint maxCell(FMath::FloorToInt(_pMax.X / cellSize), FMath::FloorToInt(_pMax.Y / cellSize));
+	for (int32 y = minCell.Y; y <= maxCell.Y; y++)
+	{
+		for (int32 x = minCell.X; x <= maxCell.X; x++)
+		{
+			if (const int32* index = cellRoots.Find(FIntPoint(x, y)))
+			{
+				stack.Add(*index);
+			}
+		}
+	}
+}
+
+void FQuadTreeSnapshot::QueryCircle(FVector _OCenter, float _radian, TArray<uint32>& outHandles, TArray<FVector2f>* outPositions) const
+{
+	const FVector2f center(_OCenter.X, _OCenter.Y);
+	const float radian2 = _radian * _radian;
+	FNodeStack stack;
+	GatherRoots(_OCenter - FVector(_radian), _OCenter + FVector(_radian), stack);
+	while (stack.Num() > 0)
+	{
+		const FQuadTreeSnapshotNode& node = nodes[stack.Pop(false)];
+		if (!BoxIntersectCircle(node.center, node.extend, center, _radian))
+			continue;
+
+		if (!node.isLeaf)
+		{
+			for (uint32 c = 0; c < node.count; c++)
+			{
+				stack.Add(node.first + c);
+			}
+			continue;
+		}
+		for (uint32 i = node.first; i < node.first + node.count; i++)
+		{
+			const FVector2f p = Dequantize(node, packedObjs[i]);
+			if (FVector2f::DistSquared(p, center) <= radian2)
+			{
+				outHandles.Add(packedObjs[i].handle);
+				if (outPositions)
+				{
+					outPositions->Add(p);
+				}
+			}
+		}
+	}
+}
+
+void FQuadTreeSnapshot::QueryBox(FVector _pMin, FVector _pMax, TArray<uint32>& outHandles, TArray<FVector2f>* outPositions) const
+{
+	FNodeStack stack;
+	GatherRoots(_pMin, _pMax, stack);
+	while (stack.Num() > 0)
+	{
+		const FQuadTreeSnapshotNode& node = nodes[stack.Pop(false)];
+		if (node.center.X + node.extend.X < _pMin.X || node.center.X - node.extend.X > _pMax.X ||
+			node.center.Y + node.extend.Y < _pMin.Y || node.center.Y - node.extend.Y > _pMax.Y)
+			continue;
+
+		if (!node.isLeaf)
+		{
+			for (uint32 c = 0; c < node.count; c++)
+			{
+				stack.Add(node.first + c);
+			}
+			continue;
+		}
+		for (uint32 i = node.first; i < node.first + node.count; i++)
+		{
+			const FVector2f p = Dequantize(node, packedObjs[i]);
+			if (p.X >= _pMin.X && p.X <= _pMax.X && p.Y >= _pMin.Y && p.Y <= _pMax.Y)
+			{
+				outHandles.Add(packedObjs[i].handle);
+				if (outPositions)
+				{
+					outPositions->Add(p);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,14 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuadTreeMass/QuadBatteryFragments.h"
+#include "MassCommonFragments.h"
+#include "MassEntityTemplateRegistry.h"
+
+void UQuadBatteryTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const
+{
+	BuildContext.AddFragment<FTransformFragment>();
+	BuildContext.AddFragment<FQuadBatteryVelocityFragment>();
+	BuildContext.AddFragment<FQuadBatteryActiveFragment>();
+	BuildContext.AddFragment<FQuadBatteryCellFragment>();
+	BuildContext.AddFragment<FQuadBatteryIdFragment>();
+}
@@ -0,0 +1,106 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuadTreeMass/QuadBatteryMassSubsystem.h"
+
+void UQuadBatteryMassSubsystem::Configure(const FVector2f& _boundsMin, const FVector2f& _boundsMax, int32 _indexDepth)
+{
+	boundsMin = _boundsMin;
+	boundsMax = _boundsMax;
+	indexDepth = FMath::Clamp(_indexDepth, 1, 10);
+	cellsPerSide = 1 << indexDepth;
+	cellSize = (boundsMax - boundsMin) / (float)cellsPerSide;
+	cellStart.Init(0, cellsPerSide * cellsPerSide + 1);
+	activeEntities.Reset();
+	bConfigured = true;
+}
+
+void UQuadBatteryMassSubsystem::Reset()
+{
+	bConfigured = false;
+	bHasScanner = false;
+	scenario = nullptr;
+	activeEntities.Empty();
+	entryCells.Empty();
+	entryHandles.Empty();
+	entryPositions.Empty();
+	cellStart.Empty();
+	sortedHandles.Empty();
+	sortedPositions.Empty();
+}
+
+FIntPoint UQuadBatteryMassSubsystem::GetCellCoord(const FVector2f& p) const
+{
+	return FIntPoint(
+		FMath::Clamp(FMath::FloorToInt((p.X - boundsMin.X) / cellSize.X), 0, cellsPerSide - 1),
+		FMath::Clamp(FMath::FloorToInt((p.Y - boundsMin.Y) / cellSize.Y), 0, cellsPerSide - 1));
+}
+
+uint32 UQuadBatteryMassSubsystem::GetCellCode(const FVector2f& p) const
+{
+	const FIntPoint coord = GetCellCoord(p);
+	return FMath::MortonCode2(coord.X) | (FMath::MortonCode2(coord.Y) << 1);
+}
+
+void UQuadBatteryMassSubsystem::BeginIndex()
+{
+	entryCells.Reset();
+	entryHandles.Reset();
+	entryPositions.Reset();
+}
+
+void UQuadBatteryMassSubsystem::AddToIndex(uint32 cell, FMassEntityHandle handle, const FVector2f& position)
+{
+	entryCells.Add(cell);
+	entryHandles.Add(handle);
+	entryPositions.Add(position);
+}
+
+// 计数排序：O(n)，按 Morton 编码连续存放
+// cellStart[i] 先累加为单元 i 的结束位置，倒序放置时逐个递减，放完正好是起始位置，不需要额外的游标数组
+void UQuadBatteryMassSubsystem::FinishIndex()
+{
+	const int32 cellCount = cellStart.Num() - 1;
+	FMemory::Memzero(cellStart.GetData(), cellStart.Num() * sizeof(int32));
+	for (uint32 cell : entryCells)
+	{
+		cellStart[cell]++;
+	}
+	for (int32 i = 1; i < cellCount; i++)
+	{
+		cellStart[i] += cellStart[i - 1];
+	}
+	cellStart[cellCount] = entryCells.Num();
+
+	sortedHandles.SetNumUninitialized(entryHandles.Num(), false);
+	sortedPositions.SetNumUninitialized(entryPositions.Num(), false);
+	for (int32 i = entryCells.Num() - 1; i >= 0; i--)
+	{
+		const int32 slot = --cellStart[entryCells[i]];
+		sortedHandles[slot] = entryHandles[i];
+		sortedPositions[slot] = entryPositions[i];
+	}
+}
+
+void UQuadBatteryMassSubsystem::QueryCircle(const FVector2f& center, float radius, TArray<FMassEntityHandle>& outEntities) const
+{
+	if (!bConfigured || sortedHandles.Num() == 0)
+		return;
+
+	const FIntPoint minCell = GetCellCoord(center - FVector2f(radius));
+	const FIntPoint maxCell = GetCellCoord(center + FVector2f(radius));
+	const float radius2 = radius * radius;
+	for (int32 y = minCell.Y; y <= maxCell.Y; y++)
+	{
+		for (int32 x = minCell.X; x <= maxCell.X; x++)
+		{
+			const uint32 code = FMath::MortonCode2(x) | (FMath::MortonCode2(y) << 1);
+			for (int32 i = cellStart[code]; i < cellStart[code + 1]; i++)
+			{
+				if (FVector2f::DistSquared(sortedPositions[i], center) <= radius2)
+				{
+					outEntities.Add(sortedHandles[i]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,198 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuadTreeMass/QuadBatteryProcessors.h"
+#include "Algo/Sort.h"
+#include "DrawDebugHelpers.h"
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "QuadTreeMass/QuadBatteryFragments.h"
+#include "QuadTreeMass/QuadBatteryMassSubsystem.h"
+#include "QuadTree/QuadTreeScenario.h"
+
+// 实体句柄与速度计划批次决定方向，结果与处理顺序、线程无关
+static FVector2f RandomDirection(const FMassEntityHandle& handle, int32 epoch)
+{
+	const FRandomStream stream(HashCombineFast(GetTypeHash(handle.Index), GetTypeHash(epoch)));
+	const float angle = stream.FRandRange(0, 2 * PI);
+	return FVector2f(FMath::Cos(angle), FMath::Sin(angle));
+}
+
+UQuadBatteryMovementProcessor::UQuadBatteryMovementProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteInGroup = UE::Mass::ProcessorGroupNames::Movement;
+}
+
+void UQuadBatteryMovementProcessor::ConfigureQueries()
+{
+	entityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadWrite);
+	entityQuery.AddRequirement<FQuadBatteryVelocityFragment>(EMassFragmentAccess::ReadWrite);
+	entityQuery.AddRequirement<FQuadBatteryIdFragment>(EMassFragmentAccess::ReadOnly);
+	entityQuery.RegisterWithProcessor(*this);
+
+	// 只读速度计划；声明后依赖求解不会让它与写子系统的处理器并行
+	ProcessorRequirements.AddSubsystemRequirement<UQuadBatteryMassSubsystem>(EMassFragmentAccess::ReadOnly);
+}
+
+void UQuadBatteryMovementProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	const UQuadBatteryMassSubsystem* subsystem = EntityManager.GetWorld() ? EntityManager.GetWorld()->GetSubsystem<UQuadBatteryMassSubsystem>() : nullptr;
+	if (!subsystem || !subsystem->IsConfigured())
+		return;
+
+	const bool bNewVelocity = appliedVelocityEpoch != subsystem->velocityEpoch;
+	const int32 epoch = subsystem->velocityEpoch;
+	appliedVelocityEpoch = epoch;
+
+	entityQuery.ForEachEntityChunk(EntityManager, Context, [subsystem, bNewVelocity, epoch](FMassExecutionContext& Context)
+	{
+		const float deltaTime = Context.GetDeltaTimeSeconds();
+		const TArrayView<FTransformFragment> transforms = Context.GetMutableFragmentView<FTransformFragment>();
+		const TArrayView<FQuadBatteryVelocityFragment> velocities = Context.GetMutableFragmentView<FQuadBatteryVelocityFragment>();
+		const TConstArrayView<FQuadBatteryIdFragment> ids = Context.GetFragmentView<FQuadBatteryIdFragment>();
+		for (int32 i = 0; i < Context.GetNumEntities(); i++)
+		{
+			FVector2f& velocity = velocities[i].value;
+			if (bNewVelocity && subsystem->scenario)
+			{
+				// 与 AQuadTree::ActorsAddVelocity 一致：第 N 次换向（velocityEpoch 为 N+1）使用场景第 N 批速度，
+				// 之前保持静止；物理约束在 XY 平面，只取平面分量
+				const FVector scenarioVelocity = epoch > 0 ? subsystem->scenario->GetVelocity(ids[i].value, epoch - 1) : FVector::ZeroVector;
+				velocity = FVector2f(scenarioVelocity.X, scenarioVelocity.Y);
+			}
+			else if (bNewVelocity)
+			{
+				velocity = RandomDirection(Context.GetEntity(i), epoch) * subsystem->speed;
+			}
+
+			FTransform& transform = transforms[i].GetMutableTransform();
+			FVector location = transform.GetLocation();
+			location.X += velocity.X * deltaTime;
+			location.Y += velocity.Y * deltaTime;
+			// 边界反弹，代替 Actor 版本中的物理碰撞
+			if (location.X < subsystem->boundsMin.X || location.X > subsystem->boundsMax.X)
+			{
+				velocity.X = -velocity.X;
+				location.X = FMath::Clamp<double>(location.X, subsystem->boundsMin.X, subsystem->boundsMax.X);
+			}
+			if (location.Y < subsystem->boundsMin.Y || location.Y > subsystem->boundsMax.Y)
+			{
+				velocity.Y = -velocity.Y;
+				location.Y = FMath::Clamp<double>(location.Y, subsystem->boundsMin.Y, subsystem->boundsMax.Y);
+			}
+			transform.SetLocation(location);
+		}
+	});
+}
+
+UQuadBatteryIndexProcessor::UQuadBatteryIndexProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+void UQuadBatteryIndexProcessor::ConfigureQueries()
+{
+	entityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+	entityQuery.AddRequirement<FQuadBatteryCellFragment>(EMassFragmentAccess::ReadWrite);
+	entityQuery.RegisterWithProcessor(*this);
+
+	ProcessorRequirements.AddSubsystemRequirement<UQuadBatteryMassSubsystem>(EMassFragmentAccess::ReadWrite);
+}
+
+void UQuadBatteryIndexProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	UQuadBatteryMassSubsystem* subsystem = EntityManager.GetWorld() ? EntityManager.GetWorld()->GetSubsystem<UQuadBatteryMassSubsystem>() : nullptr;
+	if (!subsystem || !subsystem->IsConfigured())
+		return;
+
+	subsystem->BeginIndex();
+	entityQuery.ForEachEntityChunk(EntityManager, Context, [subsystem](FMassExecutionContext& Context)
+	{
+		const TConstArrayView<FTransformFragment> transforms = Context.GetFragmentView<FTransformFragment>();
+		const TArrayView<FQuadBatteryCellFragment> cells = Context.GetMutableFragmentView<FQuadBatteryCellFragment>();
+		for (int32 i = 0; i < Context.GetNumEntities(); i++)
+		{
+			const FVector location = transforms[i].GetTransform().GetLocation();
+			const FVector2f position(location.X, location.Y);
+			cells[i].cell = subsystem->GetCellCode(position);
+			subsystem->AddToIndex(cells[i].cell, Context.GetEntity(i), position);
+		}
+	});
+	subsystem->FinishIndex();
+}
+
+UQuadBatteryScannerProcessor::UQuadBatteryScannerProcessor()
+{
+	bAutoRegisterWithProcessingPhases = true;
+	bRequiresGameThreadExecution = true; // 调试绘制
+	ExecutionFlags = (int32)EProcessorExecutionFlags::All;
+	ExecutionOrder.ExecuteAfter.Add(UQuadBatteryIndexProcessor::StaticClass()->GetFName());
+}
+
+void UQuadBatteryScannerProcessor::ConfigureQueries()
+{
+	entityQuery.AddRequirement<FQuadBatteryActiveFragment>(EMassFragmentAccess::ReadWrite);
+	entityQuery.RegisterWithProcessor(*this);
+
+	ProcessorRequirements.AddSubsystemRequirement<UQuadBatteryMassSubsystem>(EMassFragmentAccess::ReadWrite);
+}
+
+void UQuadBatteryScannerProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context)
+{
+	UWorld* world = EntityManager.GetWorld();
+	UQuadBatteryMassSubsystem* subsystem = world ? world->GetSubsystem<UQuadBatteryMassSubsystem>() : nullptr;
+	if (!subsystem || !subsystem->IsConfigured())
+		return;
+
+	inRange.Reset();
+	if (subsystem->bHasScanner)
+	{
+		subsystem->QueryCircle(subsystem->scannerLocation, subsystem->scannerRadius, inRange);
+	}
+	auto byHandle = [](const FMassEntityHandle& a, const FMassEntityHandle& b) { return a.AsNumber() < b.AsNumber(); };
+	Algo::Sort(inRange, byHandle);
+
+	// 有序归并：只改写进入/离开的实体
+	TArray<FMassEntityHandle>& active = subsystem->activeEntities;
+	auto setActive = [&EntityManager](const FMassEntityHandle& handle, bool bActive)
+	{
+		if (FQuadBatteryActiveFragment* fragment = EntityManager.GetFragmentDataPtr<FQuadBatteryActiveFragment>(handle))
+		{
+			fragment->bActive = bActive;
+		}
+	};
+	int32 i = 0, j = 0;
+	while (i < active.Num() || j < inRange.Num())
+	{
+		if (j >= inRange.Num() || (i < active.Num() && byHandle(active[i], inRange[j])))
+		{
+			setActive(active[i++], false);
+		}
+		else if (i >= active.Num() || byHandle(inRange[j], active[i]))
+		{
+			setActive(inRange[j++], true);
+		}
+		else
+		{
+			i++;
+			j++;
+		}
+	}
+	Swap(active, inRange);
+
+	if (subsystem->bDrawActive && subsystem->bHasScanner)
+	{
+		const FVector scanner(subsystem->scannerLocation.X, subsystem->scannerLocation.Y, subsystem->scannerHeight);
+		for (const FMassEntityHandle& handle : active)
+		{
+			if (const FTransformFragment* transform = EntityManager.GetFragmentDataPtr<FTransformFragment>(handle))
+			{
+				DrawDebugLine(world, transform->GetTransform().GetLocation(), scanner, FColor(0,148,220,255), false, -1, 1, 4.0f);
+			}
+		}
+	}
+}
@@ -0,0 +1,181 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "QuadTreeMass/QuadTreeMassSpawner.h"
+#include "Engine/StaticMesh.h"
+#include "MassCommonFragments.h"
+#include "MassEntityConfigAsset.h"
+#include "MassEntitySubsystem.h"
+#include "MassLODTrait.h"
+#include "MassSpawnerSubsystem.h"
+#include "MassVisualizationTrait.h"
+#include "QuadTreeMass/QuadBatteryFragments.h"
+#include "QuadTreeMass/QuadBatteryMassSubsystem.h"
+#include "QuadTree/QuadTreeScenario.h"
+
+AQuadTreeMassSpawner::AQuadTreeMassSpawner()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// 电池处理器在 PrePhysics 阶段执行，该阶段结束前不会进入 PostPhysics；放在这里写子系统参数，不会与处理器同时访问
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+}
+
+void AQuadTreeMassSpawner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UWorld* world = GetWorld();
+	UQuadBatteryMassSubsystem* subsystem = world->GetSubsystem<UQuadBatteryMassSubsystem>();
+	UMassSpawnerSubsystem* spawner = world->GetSubsystem<UMassSpawnerSubsystem>();
+	UMassEntitySubsystem* entitySubsystem = world->GetSubsystem<UMassEntitySubsystem>();
+	activeConfig = entityConfig ? entityConfig : CreateDefaultConfig();
+	if (!subsystem || !spawner || !entitySubsystem || !activeConfig)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("QuadTreeMassSpawner: missing entity config or Mass subsystems, nothing spawned"));
+		return;
+	}
+
+	subsystem->Configure(FVector2f(-height, -width), FVector2f(height, width), indexDepth);
+	subsystem->speed = speed;
+	subsystem->velocityInterval = scenario ? scenario->velocityInterval : velocityInterval;
+	subsystem->scenario = scenario;
+	subsystem->scannerRadius = affectRadianRange;
+	subsystem->bDrawActive = bDrawActive;
+	velocityTimer = 0;
+	spawnTimer = 0;
+
+	if (!scenario)
+	{
+		SpawnBatch(entityCount);
+		return;
+	}
+
+	// 场景模式：与 AQuadTree::BeginPlay 相同的区域（X 方向为 height）和生成速率
+	scenario->GetSpawnTransforms(FVector2D(height, width), scenarioTransforms);
+	SpawnBatch(scenario->spawnInterval > 0 ? 0 : scenarioTransforms.Num());
+}
+
+void AQuadTreeMassSpawner::SpawnBatch(int32 count)
+{
+	UWorld* world = GetWorld();
+	UMassSpawnerSubsystem* spawner = world->GetSubsystem<UMassSpawnerSubsystem>();
+	UMassEntitySubsystem* entitySubsystem = world->GetSubsystem<UMassEntitySubsystem>();
+	if (scenario)
+	{
+		count = FMath::Min(count, scenarioTransforms.Num() - entities.Num());
+	}
+	if (count <= 0 || !spawner || !entitySubsystem || !activeConfig)
+		return;
+
+	const FMassEntityTemplate& entityTemplate = activeConfig->GetOrCreateEntityTemplate(*world);
+	if (!entityTemplate.IsValid())
+		return;
+	const int32 first = entities.Num();
+	TArray<FMassEntityHandle> spawned;
+	spawner->SpawnEntities(entityTemplate, count, spawned);
+	entities.Append(spawned);
+
+	FMassEntityManager& entityManager = entitySubsystem->GetMutableEntityManager();
+	for (int32 i = first; i < entities.Num(); i++)
+	{
+		const FMassEntityHandle& handle = entities[i];
+		if (FQuadBatteryIdFragment* id = entityManager.GetFragmentDataPtr<FQuadBatteryIdFragment>(handle))
+		{
+			id->value = i;
+		}
+		FTransformFragment* transform = entityManager.GetFragmentDataPtr<FTransformFragment>(handle);
+		if (!transform)
+			continue;
+		if (scenario)
+		{
+			transform->GetMutableTransform() = scenarioTransforms[i];
+			continue;
+		}
+		// 没有场景时在范围内均匀分布
+		const FRandomStream stream(GetTypeHash(handle.Index));
+		const FVector location(stream.FRandRange(-height, height), stream.FRandRange(-width, width), 0);
+		transform->GetMutableTransform().SetLocation(location);
+	}
+}
+
+UMassEntityConfigAsset* AQuadTreeMassSpawner::CreateDefaultConfig()
+{
+	if (defaultConfig)
+		return defaultConfig;
+
+	UStaticMesh* mesh = batteryMesh ? batteryMesh : LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cylinder.Cylinder"));
+	if (!mesh)
+		return nullptr;
+
+	defaultConfig = NewObject<UMassEntityConfigAsset>(this, TEXT("QuadBatteryEntityConfig"), RF_Transient);
+	FMassEntityConfig& config = defaultConfig->GetMutableConfig();
+	config.AddTrait(*NewObject<UQuadBatteryTrait>(defaultConfig));
+	config.AddTrait(*NewObject<UMassLODCollectorTrait>(defaultConfig));
+
+	// 没有对应的 Actor，所有 LOD 都用实例化静态网格表示
+	UMassVisualizationTrait* visualization = NewObject<UMassVisualizationTrait>(defaultConfig);
+	visualization->StaticMeshInstanceDesc.Meshes.AddDefaulted_GetRef().Mesh = mesh;
+	visualization->Params.LODRepresentation[EMassLOD::High] = EMassRepresentationType::StaticMeshInstance;
+	visualization->Params.LODRepresentation[EMassLOD::Medium] = EMassRepresentationType::StaticMeshInstance;
+	visualization->Params.LODRepresentation[EMassLOD::Low] = EMassRepresentationType::StaticMeshInstance;
+	visualization->Params.LODRepresentation[EMassLOD::Off] = EMassRepresentationType::None;
+	config.AddTrait(*visualization);
+	return defaultConfig;
+}
+
+void AQuadTreeMassSpawner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UWorld* world = GetWorld())
+	{
+		if (UMassSpawnerSubsystem* spawner = world->GetSubsystem<UMassSpawnerSubsystem>())
+		{
+			if (entities.Num() > 0)
+			{
+				spawner->DestroyEntities(entities);
+			}
+		}
+		if (UQuadBatteryMassSubsystem* subsystem = world->GetSubsystem<UQuadBatteryMassSubsystem>())
+		{
+			subsystem->Reset();
+		}
+	}
+	entities.Reset();
+	Super::EndPlay(EndPlayReason);
+}
+
+void AQuadTreeMassSpawner::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	UQuadBatteryMassSubsystem* subsystem = GetWorld()->GetSubsystem<UQuadBatteryMassSubsystem>();
+	if (!subsystem || !subsystem->IsConfigured())
+		return;
+
+	// 场景的生成速率：每隔 spawnInterval 秒生成 spawnPerTick 个，与 AQuadTree 的定时器相同
+	if (scenario && scenario->spawnInterval > 0 && entities.Num() < scenarioTransforms.Num())
+	{
+		spawnTimer += DeltaTime;
+		int32 batches = 0;
+		for (; spawnTimer >= scenario->spawnInterval; spawnTimer -= scenario->spawnInterval)
+		{
+			batches++;
+		}
+		SpawnBatch(batches * scenario->spawnPerTick);
+	}
+
+	// 速度计划：处理器在 velocityEpoch 变化的那一帧为所有实体换方向
+	velocityTimer += DeltaTime;
+	if (velocityTimer > subsystem->velocityInterval)
+	{
+		velocityTimer = 0;
+		subsystem->velocityEpoch++;
+	}
+
+	subsystem->bHasScanner = traceActor != nullptr;
+	if (traceActor)
+	{
+		const FVector location = traceActor->GetActorLocation();
+		subsystem->scannerLocation = FVector2f(location.X, location.Y);
+	}
+	subsystem->scannerRadius = affectRadianRange;
+	subsystem->bDrawActive = bDrawActive;
+}
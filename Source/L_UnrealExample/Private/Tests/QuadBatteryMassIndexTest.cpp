@@ -0,0 +1,60 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTreeMass/QuadBatteryMassSubsystem.h"
+
+// 线性四叉树索引：计数排序后的圆形查询与逐个比较的结果相同；重复构建（复用数组）结果不变
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadBatteryMassIndexTest, "L_UnrealExample.QuadTreeMass.LinearIndex",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadBatteryMassIndexTest::RunTest(const FString& Parameters)
+{
+	UQuadBatteryMassSubsystem* subsystem = NewObject<UQuadBatteryMassSubsystem>();
+	subsystem->Configure(FVector2f(-500, -500), FVector2f(500, 500), 5);
+
+	FRandomStream random(33);
+	TArray<FVector2f> positions;
+	for (int32 frame = 0; frame < 3; frame++)
+	{
+		// 每帧数量不同，部分实体超出边界（归入边缘单元）
+		positions.Reset();
+		const int32 count = 300 + frame * 117;
+		subsystem->BeginIndex();
+		for (int32 i = 0; i < count; i++)
+		{
+			const FVector2f p(random.FRandRange(-550, 550), random.FRandRange(-550, 550));
+			positions.Add(p);
+			subsystem->AddToIndex(subsystem->GetCellCode(p), FMassEntityHandle(i, frame + 1), p);
+		}
+		subsystem->FinishIndex();
+		TestEqual(TEXT("every entity indexed"), subsystem->GetIndexedCount(), count);
+
+		for (int32 q = 0; q < 8; q++)
+		{
+			const FVector2f center(random.FRandRange(-500, 500), random.FRandRange(-500, 500));
+			const float radius = random.FRandRange(10, 300);
+			TArray<FMassEntityHandle> found;
+			subsystem->QueryCircle(center, radius, found);
+
+			TSet<FMassEntityHandle> expected;
+			for (int32 i = 0; i < positions.Num(); i++)
+			{
+				if (FVector2f::DistSquared(positions[i], center) <= radius * radius)
+				{
+					expected.Add(FMassEntityHandle(i, frame + 1));
+				}
+			}
+			TestEqual(TEXT("query count matches brute force"), found.Num(), expected.Num());
+			for (const FMassEntityHandle& handle : found)
+			{
+				TestTrue(TEXT("query result expected"), expected.Contains(handle));
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,98 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 烘焙索引：正常数据恢复后包含全部对象；结构损坏的数据被拒绝；离开叶子的对象恢复后只出现一次
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeBakedIndexTest, "L_UnrealExample.QuadTree.BakedIndex",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeBakedIndexTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	const float halfX = quadTree->height;
+	const float halfY = quadTree->width;
+	FRandomStream random(35);
+	TArray<ABattery*> batteries;
+	for (int32 i = 0; i < 100; i++)
+	{
+		batteries.Add(testWorld.Spawn<ABattery>(FVector(random.FRandRange(-halfX, halfX), random.FRandRange(-halfY, halfY), 0)));
+	}
+
+	quadTree->BakeIndex();
+	if (!TestTrue(TEXT("index baked"), quadTree->bakedNodes.Num() > 1))
+		return false;
+	const TArray<FQuadTreeBakedNode> baked = quadTree->bakedNodes;
+
+	TArray<ABattery*> collected;
+	TestTrue(TEXT("valid index restores"), quadTree->RestoreBakedIndex());
+	quadTree->root->CollectObjs(collected);
+	TestEqual(TEXT("restored tree holds every object"), collected.Num(), batteries.Num());
+
+	// 每种损坏各自从正确的数据开始
+	auto expectRejected = [this, quadTree, &baked](const TCHAR* what, TFunctionRef<void(TArray<FQuadTreeBakedNode>&)> corrupt)
+	{
+		quadTree->bakedNodes = baked;
+		corrupt(quadTree->bakedNodes);
+		TestFalse(what, quadTree->RestoreBakedIndex());
+	};
+	expectRejected(TEXT("inner node with objects rejected"), [](TArray<FQuadTreeBakedNode>& nodes)
+	{
+		nodes[0].objCount = 1; // 根节点已细分
+	});
+	expectRejected(TEXT("child before parent rejected"), [](TArray<FQuadTreeBakedNode>& nodes)
+	{
+		nodes.Last().child[0] = 0;
+	});
+	expectRejected(TEXT("child referenced twice rejected"), [](TArray<FQuadTreeBakedNode>& nodes)
+	{
+		const int32* first = nullptr;
+		for (int32& child : nodes[0].child)
+		{
+			if (child == INDEX_NONE)
+				continue;
+			if (!first)
+			{
+				first = &child;
+				continue;
+			}
+			child = *first;
+			break;
+		}
+	});
+	expectRejected(TEXT("overlapping object ranges rejected"), [](TArray<FQuadTreeBakedNode>& nodes)
+	{
+		for (FQuadTreeBakedNode& node : nodes)
+		{
+			if (node.isLeaf && node.objCount > 0)
+			{
+				node.objCount++;
+				break;
+			}
+		}
+	});
+	quadTree->bakedNodes = baked;
+	quadTree->leafCapacity++;
+	TestFalse(TEXT("config change rejected"), quadTree->RestoreBakedIndex());
+	quadTree->leafCapacity--;
+
+	// 移动到其他叶子的对象被跳过后重新插入，不会留在原叶子
+	ABattery* moved = batteries[0];
+	moved->SetActorLocation(FVector(-moved->GetActorLocation().X, -moved->GetActorLocation().Y, 0));
+	TestTrue(TEXT("index with a moved object restores"), quadTree->RestoreBakedIndex());
+	collected.Reset();
+	quadTree->root->CollectObjs(collected);
+	TestEqual(TEXT("moved object indexed once"), collected.FilterByPredicate([moved](ABattery* obj) { return obj == moved; }).Num(), 1);
+	TArray<ABattery*> hits;
+	const FVector2f location(moved->GetActorLocation().X, moved->GetActorLocation().Y);
+	quadTree->root->QueryBox(location - FVector2f(1), location + FVector2f(1), hits);
+	TestTrue(TEXT("moved object found at its new location"), hits.Contains(moved));
+	return true;
+}
+
+#endif
@@ -0,0 +1,56 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Async/ParallelFor.h"
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 多个线程同时暂存插入，同步点按每帧预算分批提交，最终每个对象恰好插入一次
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeConcurrentInsertTest, "L_UnrealExample.QuadTree.ConcurrentInsert",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeConcurrentInsertTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	testWorld.world->PersistentLevel->bIsVisible = true;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	quadTree->root = quadTree->MakeRootNode(FVector::ZeroVector, FVector(quadTree->height, quadTree->width, 0));
+	quadTree->maxInsertsPerFrame = 100;
+
+	const float halfX = quadTree->height;
+	const float halfY = quadTree->width;
+	FRandomStream random(26);
+	TArray<ABattery*> batteries;
+	for (int32 i = 0; i < 256; i++)
+	{
+		batteries.Add(testWorld.Spawn<ABattery>(FVector(random.FRandRange(-halfX, halfX), random.FRandRange(-halfY, halfY), 0)));
+	}
+	ParallelFor(batteries.Num(), [quadTree, &batteries](int32 i)
+	{
+		quadTree->QueueInsert(batteries[i]);
+	});
+
+	quadTree->FlushPendingInserts();
+	TArray<ABattery*> collected;
+	quadTree->root->CollectObjs(collected);
+	TestEqual(TEXT("first flush respects the per-frame budget"), collected.Num(), quadTree->maxInsertsPerFrame);
+
+	for (int32 frame = 0; frame < 3; frame++)
+	{
+		quadTree->FlushPendingInserts();
+	}
+	collected.Reset();
+	quadTree->root->CollectObjs(collected);
+	TestEqual(TEXT("every queued object inserted"), collected.Num(), batteries.Num());
+	for (ABattery* obj : batteries)
+	{
+		TestTrue(TEXT("object registered"), quadTree->ResolveHandle(obj->quadTreeHandle) == obj);
+	}
+	TestTrue(TEXT("queue drained"), quadTree->pendingInserts.IsEmpty());
+	return true;
+}
+
+#endif
@@ -0,0 +1,60 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 子节点不再反向强引用根节点：释放根节点后整棵树被回收；内存统计覆盖每个节点
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeMemoryTest, "L_UnrealExample.QuadTree.OwnershipAndMemory",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeMemoryTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	quadTree->root = quadTree->MakeRootNode(FVector::ZeroVector, FVector(quadTree->height, quadTree->width, 0));
+	const float halfX = quadTree->height;
+	const float halfY = quadTree->width;
+	FRandomStream random(38);
+	for (int32 i = 0; i < 100; i++)
+	{
+		ABattery* obj = testWorld.Spawn<ABattery>(FVector(random.FRandRange(-halfX, halfX), random.FRandRange(-halfY, halfY), 0));
+		quadTree->RegisterObj(obj);
+		quadTree->InsertIntoIndex(obj);
+	}
+
+	FQuadTreeStats stats;
+	quadTree->CollectIndexStats(stats, false);
+	FQuadTreeMemoryStats memory;
+	quadTree->GetIndexMemory(memory);
+	TestEqual(TEXT("every node accounted"), memory.nodeCount, stats.nodeCount);
+	TestTrue(TEXT("node bytes at least the nodes themselves"), memory.nodeBytes >= stats.nodeCount * sizeof(QuadTreeNode));
+	TestTrue(TEXT("object lists accounted"), memory.objListBytes >= 100 * (sizeof(ABattery*) + 2 * sizeof(float)));
+
+	// 只通过弱引用观察一个最深的子节点
+	TWeakPtr<QuadTreeNode> deepChild;
+	for (QuadTreeNode* node = quadTree->root.Get(); node && !node->isLeaf; )
+	{
+		QuadTreeNode* next = nullptr;
+		for (const TSharedPtr<QuadTreeNode>& child : node->child_node)
+		{
+			if (child.IsValid())
+			{
+				deepChild = child;
+				next = child.Get();
+				break;
+			}
+		}
+		node = next;
+	}
+	if (!TestTrue(TEXT("tree has children"), deepChild.IsValid()))
+		return false;
+	quadTree->root.Reset();
+	TestFalse(TEXT("subtree freed with the root"), deepChild.IsValid());
+	return true;
+}
+
+#endif
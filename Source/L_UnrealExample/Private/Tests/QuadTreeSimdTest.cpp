@@ -0,0 +1,70 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTreeSimd.h"
+
+// 批量检测与逐个比较的位掩码、命中数一致；覆盖不足 4 个的尾部和跨 32 位字的长度
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeSimdKernelTest, "L_UnrealExample.QuadTree.SimdKernels",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeSimdKernelTest::RunTest(const FString& Parameters)
+{
+	FRandomStream random(37);
+	TArray<float> xs;
+	TArray<float> ys;
+	TArray<uint32> mask;
+	for (int32 count : { 0, 1, 3, 4, 5, 31, 32, 33, 67, 130 })
+	{
+		xs.SetNumUninitialized(count);
+		ys.SetNumUninitialized(count);
+		for (int32 i = 0; i < count; i++)
+		{
+			xs[i] = random.FRandRange(-100, 100);
+			ys[i] = random.FRandRange(-100, 100);
+		}
+		// 恰好落在边界上的点也要命中
+		if (count > 2)
+		{
+			xs[1] = 30;
+			ys[1] = 0;
+			xs[2] = -20;
+			ys[2] = 40;
+		}
+		mask.SetNumUninitialized(FMath::Max(QuadTreeSimd::MaskWords(count), 1));
+
+		const float cx = 0;
+		const float cy = 0;
+		const float radius = 30;
+		const int32 circleHits = QuadTreeSimd::TestCircle(xs.GetData(), ys.GetData(), count, cx, cy, radius, mask.GetData());
+		int32 expectedHits = 0;
+		for (int32 i = 0; i < count; i++)
+		{
+			const bool bExpected = (xs[i] - cx) * (xs[i] - cx) + (ys[i] - cy) * (ys[i] - cy) <= radius * radius;
+			expectedHits += bExpected ? 1 : 0;
+			TestEqual(TEXT("circle bit"), (mask[i >> 5] >> (i & 31)) & 1u, bExpected ? 1u : 0u);
+		}
+		TestEqual(TEXT("circle hit count"), circleHits, expectedHits);
+
+		const FVector2f pMin(-20, -10);
+		const FVector2f pMax(50, 40);
+		const int32 boxHits = QuadTreeSimd::TestBox(xs.GetData(), ys.GetData(), count, pMin, pMax, mask.GetData());
+		TArray<int32> visited;
+		QuadTreeSimd::ForEachHit(mask.GetData(), count, [&visited](int32 i) { visited.Add(i); });
+		TArray<int32> expected;
+		for (int32 i = 0; i < count; i++)
+		{
+			if (xs[i] >= pMin.X && xs[i] <= pMax.X && ys[i] >= pMin.Y && ys[i] <= pMax.Y)
+			{
+				expected.Add(i);
+			}
+		}
+		TestEqual(TEXT("box hit count"), boxHits, expected.Num());
+		TestTrue(TEXT("box hits visited in order"), visited == expected);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 双缓冲发布：读者持有的快照在之后的发布中不被修改；没有读者时两份缓冲交替复用，不重新分配
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeSnapshotBufferTest, "L_UnrealExample.QuadTree.SnapshotDoubleBuffer",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeSnapshotBufferTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	quadTree->root = quadTree->MakeRootNode(FVector::ZeroVector, FVector(quadTree->height, quadTree->width, 0));
+	auto addBattery = [quadTree, &testWorld](const FVector& location)
+	{
+		ABattery* obj = testWorld.Spawn<ABattery>(location);
+		quadTree->RegisterObj(obj);
+		quadTree->InsertIntoIndex(obj);
+	};
+	addBattery(FVector(10, 20, 0));
+
+	quadTree->PublishSnapshot();
+	const FQuadTreeSnapshotPtr held = quadTree->GetSnapshot();
+	if (!TestTrue(TEXT("snapshot published"), held.IsValid()))
+		return false;
+	const FQuadTreeSnapshot* heldAddress = held.Get();
+	TestEqual(TEXT("held snapshot content"), held->packedObjs.Num(), 1);
+
+	// 读者仍持有第一份，后续发布不能写入它
+	for (int32 i = 0; i < 3; i++)
+	{
+		addBattery(FVector(-30.0 * i, 40, 0));
+		quadTree->PublishSnapshot();
+		TestTrue(TEXT("new snapshot published"), quadTree->GetSnapshot().Get() != heldAddress);
+		TestEqual(TEXT("published snapshot sees new objects"), quadTree->GetSnapshot()->packedObjs.Num(), 2 + i);
+	}
+	TestEqual(TEXT("held snapshot unchanged"), held->packedObjs.Num(), 1);
+
+	// 没有读者持有时两份缓冲交替复用
+	quadTree->PublishSnapshot();
+	const FQuadTreeSnapshot* first = quadTree->GetSnapshot().Get();
+	quadTree->PublishSnapshot();
+	const FQuadTreeSnapshot* second = quadTree->GetSnapshot().Get();
+	quadTree->PublishSnapshot();
+	TestTrue(TEXT("buffers alternate"), first != second);
+	TestTrue(TEXT("back buffer reused"), quadTree->GetSnapshot().Get() == first);
+	return true;
+}
+
+#endif
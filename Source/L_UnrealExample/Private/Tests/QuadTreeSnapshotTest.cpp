@@ -0,0 +1,75 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 叶子内 16 位量化坐标解量化后误差不超过半个量化步长，快照的圆形查询与逐个比较的结果一致
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeSnapshotQuantizeTest, "L_UnrealExample.QuadTree.SnapshotQuantization",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeSnapshotQuantizeTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	quadTree->root = quadTree->MakeRootNode(FVector::ZeroVector, FVector(quadTree->height, quadTree->width, 0));
+
+	const float halfX = quadTree->height;
+	const float halfY = quadTree->width;
+	FRandomStream random(30);
+	TArray<ABattery*> batteries;
+	for (int32 i = 0; i < 200; i++)
+	{
+		ABattery* obj = testWorld.Spawn<ABattery>(FVector(random.FRandRange(-halfX, halfX), random.FRandRange(-halfY, halfY), 0));
+		quadTree->RegisterObj(obj);
+		quadTree->InsertIntoIndex(obj);
+		batteries.Add(obj);
+	}
+	quadTree->PublishSnapshot();
+	const FQuadTreeSnapshotPtr snapshot = quadTree->GetSnapshot();
+	if (!TestTrue(TEXT("snapshot published"), snapshot.IsValid()))
+		return false;
+	TestEqual(TEXT("every object packed"), snapshot->packedObjs.Num(), batteries.Num());
+
+	// 往返误差：半个量化步长，再留出 float 在该量级上的舍入
+	for (const FQuadTreeSnapshotNode& node : snapshot->nodes)
+	{
+		if (!node.isLeaf)
+			continue;
+		const FVector2f tolerance = node.extend * (1.0f / MAX_uint16) + FVector2f(1e-3f);
+		for (uint32 k = node.first; k < node.first + node.count; k++)
+		{
+			const FQuadTreePackedObj& packed = snapshot->packedObjs[k];
+			const ABattery* obj = quadTree->ResolveHandle(packed.handle);
+			if (!TestNotNull(TEXT("handle resolves"), obj))
+				continue;
+			const FVector2f actual(obj->GetActorLocation().X, obj->GetActorLocation().Y);
+			const FVector2f error = (FQuadTreeSnapshot::Dequantize(node, packed) - actual).GetAbs();
+			TestTrue(TEXT("dequantized within half a step"), error.X <= tolerance.X && error.Y <= tolerance.Y);
+		}
+	}
+
+	// 圆形查询：明显在圆内的都返回，返回的都不超出圆外一个量化误差
+	const FVector center(random.FRandRange(-200, 200), random.FRandRange(-200, 200), 0);
+	const float radius = 180;
+	TArray<uint32> handles;
+	snapshot->QueryCircle(center, radius, handles);
+	for (ABattery* obj : batteries)
+	{
+		const double distance = FVector::Dist2D(obj->GetActorLocation(), center);
+		if (distance < radius - 0.1)
+		{
+			TestTrue(TEXT("inside object returned"), handles.Contains(obj->quadTreeHandle));
+		}
+		else if (distance > radius + 0.1)
+		{
+			TestFalse(TEXT("outside object not returned"), handles.Contains(obj->quadTreeHandle));
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,56 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "QuadTree/QuadTree.h"
+#include "QuadTreeTestWorld.h"
+
+// 关卡卸载只处理该关卡登记的单元和对象：卸载后单元全部摘除，对象句柄全部回收
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FQuadTreeStreamingCellUnloadTest, "L_UnrealExample.QuadTree.StreamingCellUnload",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FQuadTreeStreamingCellUnloadTest::RunTest(const FString& Parameters)
+{
+	FQuadTreeTestWorld testWorld;
+	AQuadTree* quadTree = testWorld.Spawn<AQuadTree>(FVector::ZeroVector);
+	quadTree->bUseStreamingCells = true;
+	quadTree->cellSize = 1000;
+	ULevel* level = testWorld.world->PersistentLevel;
+
+	FRandomStream random(29);
+	TArray<ABattery*> batteries;
+	for (int32 i = 0; i < 64; i++)
+	{
+		ABattery* obj = testWorld.Spawn<ABattery>(FVector(random.FRandRange(-2500, 2500), random.FRandRange(-2500, 2500), 0));
+		quadTree->RegisterObj(obj);
+		quadTree->InsertIntoIndex(obj);
+		batteries.Add(obj);
+	}
+
+	const FQuadTreeLevelEntry* entry = quadTree->levelEntries.Find(level);
+	if (!TestNotNull(TEXT("level entry"), entry))
+		return false;
+	TestEqual(TEXT("entry owns every attached cell"), entry->cells.Num(), quadTree->cells.Num());
+	TestEqual(TEXT("entry lists every registered object"), entry->objs.Num(), batteries.Num());
+
+	// 移动到另一个单元后重新分配，仍由同一关卡拥有，不登记为外来对象
+	batteries[0]->SetActorLocation(batteries[0]->GetActorLocation() + FVector(quadTree->cellSize, 0, 0));
+	quadTree->UpdateIndex();
+	TestEqual(TEXT("same-level move is not foreign"), entry->foreignObjs.Num(), 0);
+	TestTrue(TEXT("moved object's cell attached"), quadTree->cells.Contains(quadTree->GetCellCoord(batteries[0]->GetActorLocation())));
+
+	quadTree->OnLevelRemoved(level, testWorld.world);
+	TestEqual(TEXT("cells detached"), quadTree->cells.Num(), 0);
+	TestEqual(TEXT("level entry removed"), quadTree->levelEntries.Num(), 0);
+	TestEqual(TEXT("no orphans left"), quadTree->orphans.Num(), 0);
+	for (ABattery* obj : batteries)
+	{
+		TestEqual(TEXT("handle released"), obj->quadTreeHandle, MAX_uint32);
+	}
+	TestEqual(TEXT("all handles free"), quadTree->freeHandles.Num(), batteries.Num());
+	return true;
+}
+
+#endif
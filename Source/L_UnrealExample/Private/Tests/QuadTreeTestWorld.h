@@ -0,0 +1,40 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CoreMinimal.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+/**
+ * 自动化测试用的临时游戏世界：不调用 BeginPlay，生成的 Actor 只执行构造脚本，析构时整个世界销毁
+ */
+struct FQuadTreeTestWorld
+{
+	UWorld* world = nullptr;
+
+	FQuadTreeTestWorld()
+	{
+		world = UWorld::CreateWorld(EWorldType::Game, false);
+		FWorldContext& context = GEngine->CreateNewWorldContext(EWorldType::Game);
+		context.SetCurrentWorld(world);
+	}
+
+	~FQuadTreeTestWorld()
+	{
+		GEngine->DestroyWorldContext(world);
+		world->DestroyWorld(false);
+	}
+
+	template<typename T>
+	T* Spawn(const FVector& location)
+	{
+		FActorSpawnParameters params;
+		params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		return world->SpawnActor<T>(location, FRotator::ZeroRotator, params);
+	}
+};
+
+#endif
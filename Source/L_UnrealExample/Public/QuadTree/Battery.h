@@ -6,6 +6,8 @@
 #include "Engine/StaticMeshActor.h"
 #include "Battery.generated.h"
 
+class AQuadTree;
+
 UCLASS()
 class L_UNREALEXAMPLE_API ABattery : public AStaticMeshActor
 {
@@ -24,6 +26,12 @@ public:
 	virtual void Tick(float DeltaTime) override;
 	void ActiveState(bool _bActive, AActor* _targetActor);
 
+	// 网络相关性由所属 AQuadTree 的兴趣管理结果决定，未启用时使用默认的距离判断
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	// 由 AQuadTree 按重要度分档批量设置 Tick 频率
+	void SetTickThrottle(int32 _bucket, float _interval, bool _bEnable);
+
 public:
 	UPROPERTY(EditAnywhere)
 	UMaterial* m_normal;
@@ -35,4 +43,13 @@ public:
 	AActor* targetActor;
 	
 	bool bActive = false;
+
+	// 在 AQuadTree 对象表中的句柄，未注册时为 MAX_uint32
+	uint32 quadTreeHandle = MAX_uint32;
+
+	// 注册到的 AQuadTree
+	TWeakObjectPtr<AQuadTree> quadTree;
+
+	// 当前的重要度分档，INDEX_NONE 表示未设置
+	int32 significanceBucket = INDEX_NONE;
 };
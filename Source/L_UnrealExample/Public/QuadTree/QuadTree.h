@@ -4,10 +4,98 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Containers/Queue.h"
 #include "Battery.h"
 #include "QuadTreeNode.h"
+#include "QuadTreeSnapshot.h"
+#include "QuadTreeScenario.h"
 #include "QuadTree.generated.h"
 
+// 叶子容量/深度自动调优模式
+UENUM()
+enum class EQuadTreeTuneMode : uint8
+{
+	Off,
+	Recommend,	// 试验各配置后恢复原配置，只在日志中给出推荐值
+	AutoApply,	// 试验后在安全点应用测得的最优配置
+};
+
+// 自动调优的运行状态
+struct FQuadTreeTuneState
+{
+	int32 frames = 0;         // 当前窗口已统计的帧数
+	double seconds = 0;       // 当前窗口内 UpdateState + TraceObjectInRange 的耗时
+	int64 objFrames = 0;      // 当前窗口内每帧对象数之和，用于按对象数归一化
+	FIntPoint original;       // 开始调优时的配置 (capacity, depth)
+	FIntPoint best;
+	double bestCost = -1;     // 每对象每帧耗时（秒）
+	TArray<FIntPoint> candidates; // 待试验的配置
+	TSet<FIntPoint> tried;
+	bool bDone = false;
+};
+
+// 重要度分档：到扫描器的距离不超过 maxDistance 的节点，其中的对象使用该档的 Tick 设置
+USTRUCT()
+struct FQuadTreeSignificanceBucket
+{
+	GENERATED_BODY()
+
+	FQuadTreeSignificanceBucket() {}
+	FQuadTreeSignificanceBucket(float _maxDistance, float _tickInterval, bool _bDisableTick)
+		: maxDistance(_maxDistance), tickInterval(_tickInterval), bDisableTick(_bDisableTick) {}
+
+	UPROPERTY(EditAnywhere)
+	float maxDistance = 500;
+
+	// 0 表示每帧 Tick
+	UPROPERTY(EditAnywhere)
+	float tickInterval = 0;
+
+	UPROPERTY(EditAnywhere)
+	bool bDisableTick = false;
+};
+
+// 兴趣管理的观察者：viewActor 不为空时跟随其位置
+USTRUCT()
+struct FQuadTreeViewer
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere)
+	AActor* viewActor = nullptr;
+
+	UPROPERTY(EditAnywhere)
+	FVector location = FVector::ZeroVector;
+
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0"))
+	float cullRadius = 1500;
+};
+
+// 每个观察者的相关对象集合（按指针排序）以及本次更新的增量
+struct FQuadTreeViewerRelevancy
+{
+	const AActor* viewer = nullptr; // 为空表示本地模拟的观察者
+	TArray<ABattery*> relevant;
+	TArray<ABattery*> added;
+	TArray<ABattery*> removed;
+};
+
+// 流式单元：每个单元拥有一棵子树，随所属关卡加载时挂接、卸载时整棵摘除
+struct FQuadTreeCell
+{
+	TSharedPtr<QuadTreeNode> root;
+	TArray<ULevel*> levels;       // 拥有该单元的关卡，全部卸载后摘除
+	TSet<ABattery*> foreignObjs;  // 来自其他关卡、移动进本单元的对象
+};
+
+// 关卡在索引中拥有的内容：卸载时只处理这些，代价与该关卡的规模成正比，与整个世界无关
+struct FQuadTreeLevelEntry
+{
+	TArray<FIntPoint> cells;                 // 参与拥有的单元
+	TSet<ABattery*> objs;                    // 已登记句柄的对象
+	TMap<ABattery*, FIntPoint> foreignObjs;  // 移动进其他关卡单元的对象及其所在单元
+};
+
 UCLASS()
 class L_UNREALEXAMPLE_API AQuadTree : public AActor
 {
@@ -20,12 +108,107 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:
+	virtual void Serialize(FArchive& Ar) override;
+#if WITH_EDITOR
+	// 保存/烘焙关卡时为关卡中预先放置的电池建好索引
+	virtual void PreSave(FObjectPreSaveContext ObjectSaveContext) override;
+#endif
+
+	// 由预先放置的电池构建烘焙索引
+	void BakeIndex();
+
+	// 校验并恢复烘焙索引，失败时返回 false
+	bool RestoreBakedIndex();
+
+	// 影响树结构的配置的哈希，配置变化后烘焙结果失效
+	uint32 GetBakeConfigHash() const;
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 	void SpawnActors();
 	void ActorsAddVelocity();
+
+	// 线程安全：任意线程（异步生成器、流式加载）都可调用，对象先进入暂存队列
+	void QueueInsert(ABattery* obj);
+
+	// 同步点：在游戏线程把暂存队列中的对象提交到四叉树，Tick 开始时调用
+	void FlushPendingInserts();
+
+	// 游戏线程：UpdateState 之后构建并发布只读快照
+	void PublishSnapshot();
+
+	// 任意线程：获取最近一次发布的快照，持有期间内容不会被修改
+	FQuadTreeSnapshotPtr GetSnapshot() const;
+
+	// 对象表：分配/回收 32 位句柄，快照中用句柄代替对象指针
+	uint32 RegisterObj(ABattery* obj);
+	void UnregisterObj(ABattery* obj);
+
+	// 游戏线程：由快照中的句柄取回对象，对象已移除时返回 nullptr
+	ABattery* ResolveHandle(uint32 handle) const;
+
+	// 最近一次发布的快照占用的内存（字节）
+	SIZE_T GetSnapshotMemory() const;
+
+	// 整个索引占用的内存：节点、对象列表及其空闲容量、对象表、快照双缓冲
+	void GetIndexMemory(FQuadTreeMemoryStats& stats) const;
+
+	// 创建空的根节点，使用当前的容量/深度配置
+	TSharedPtr<QuadTreeNode> MakeRootNode(FVector _center, FVector _extend) const;
+
+	// 把对象放入索引：固定区域模式插入根节点，流式单元模式按网格路由到所在单元
+	void InsertIntoIndex(ABattery* obj);
+
+	// 更新所有子树，并重新分配离开子树范围的对象
+	void UpdateIndex();
+
+	// 范围检测；流式单元模式下只检测与扫描范围相交的单元
+	void TraceIndex();
+
+	// 与上一帧的范围内对象比较，只对状态切换的对象调用 ActiveState 并批量广播事件
+	void ApplyRangeTransitions();
+
+	// 按到扫描器的距离为节点分档，分档变化时批量调整其中电池的 Tick 频率
+	void UpdateSignificance();
+
+	// 视锥查询：返回视锥内的对象
+	void QueryFrustum(const FConvexVolume& frustum, TArray<ABattery*>& outObjs) const;
+
+	// 以玩家相机当前的视图构建视锥并查询，没有相机时返回 false
+	bool QueryPlayerCameraFrustum(const APlayerController* player, TArray<ABattery*>& outObjs) const;
+
+	// 兴趣管理：一次共享遍历得到每个观察者的相关对象集合，并与上次结果比较得到增量
+	void UpdateRelevancy(const TArray<FQuadTreeViewer>& viewers);
+
+	// 本帧的观察者：服务器上的玩家视点加上模拟观察者
+	void GatherViewers(TArray<FQuadTreeViewer>& outViewers) const;
+
+	// 供 ABattery::IsNetRelevantFor 使用；观察者没有参与兴趣管理时 bOutKnown 为 false
+	bool IsRelevantFor(const ABattery* obj, const AActor* realViewer, const AActor* viewTarget, bool& bOutKnown) const;
+
+	const TArray<FQuadTreeViewerRelevancy>& GetViewerRelevancy() const { return viewerRelevancy; }
+
+	// 汇总所有子树的统计信息
+	void CollectIndexStats(FQuadTreeStats& stats, bool bReset);
+
+	// 流式单元
+	FIntPoint GetCellCoord(const FVector& location) const;
+	FQuadTreeCell& AttachCell(FIntPoint coord, ULevel* owner);
+	void DetachCell(FIntPoint coord);	// O(1) 摘除整棵子树
+	void AddForeignObj(FQuadTreeCell& cell, FIntPoint coord, ABattery* obj);
+	void RemoveForeignObj(FQuadTreeCell& cell, ABattery* obj);
+	void RetryOrphans();
+	void OnLevelAdded(ULevel* level, UWorld* world);
+	void OnLevelRemoved(ULevel* level, UWorld* world);
+
+	// 以新的容量/深度重建整棵树，只能在安全点（游戏线程，且没有遍历正在进行）调用
+	void RebuildTree(int32 _capacity, int32 _depth);
+
+	// 自动调优：统计一个窗口内的耗时，窗口结束时切换到下一个候选配置
+	void TuneStep(double frameSeconds);
 	
 public:
 	UPROPERTY(EditAnywhere)
@@ -49,10 +232,158 @@ public:
 	UPROPERTY(EditAnywhere)
 	float affectRadianRange=50;
 
+	// 可复现的测试场景；设置后生成数量、位置、速率与速度计划都由场景决定，cubeCount/playRate 不再使用
+	UPROPERTY(EditAnywhere)
+	UQuadTreeScenario* scenario;
+
+	// 每帧最多提交的暂存对象数，<=0 表示不限制；用于把大批量插入分摊到多帧
+	UPROPERTY(EditAnywhere)
+	int32 maxInsertsPerFrame=512;
+
+	// 叶子容量，超过后细分
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	int32 leafCapacity=4;
+
+	// 最大深度
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	int32 maxDepth=8;
+
+	UPROPERTY(EditAnywhere)
+	EQuadTreeTuneMode tuneMode=EQuadTreeTuneMode::Off;
+
+	// 每个候选配置统计的帧数
+	UPROPERTY(EditAnywhere, meta=(ClampMin="10"))
+	int32 tuneWindowFrames=120;
+
+	// 流式单元模式：按 cellSize 划分网格，每个单元一棵子树，随关卡流式加载挂接/摘除
+	UPROPERTY(EditAnywhere)
+	bool bUseStreamingCells=false;
+
+	UPROPERTY(EditAnywhere, meta=(ClampMin="100", EditCondition="bUseStreamingCells"))
+	float cellSize=2000;
+
+	// 按距离节流电池的 Tick；超出所有分档距离的节点使用最后一档
+	UPROPERTY(EditAnywhere)
+	bool bThrottleTicks=false;
+
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bThrottleTicks"))
+	TArray<FQuadTreeSignificanceBucket> significanceBuckets;
+
+	// 计算距离的扫描器，为空时使用 traceActor
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bThrottleTicks"))
+	TArray<AActor*> significanceSources;
+
+	// 视锥查询：节点在 Z 方向的半高，以及对象的包围球半径
+	UPROPERTY(EditAnywhere)
+	float frustumHalfHeight=100;
+
+	UPROPERTY(EditAnywhere)
+	float frustumObjRadius=20;
+
+	// 兴趣管理：由四叉树计算每个观察者的相关对象，代替逐个 Actor 的距离判断
+	UPROPERTY(EditAnywhere)
+	bool bUseInterestManagement=false;
+
+	// 玩家视点使用的裁剪半径
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bUseInterestManagement"))
+	float netCullRadius=1500;
+
+	// 本地测试用的模拟观察者，不需要服务器
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bUseInterestManagement"))
+	TArray<FQuadTreeViewer> simulatedViewers;
+
+	UPROPERTY(EditAnywhere, meta=(EditCondition="bUseInterestManagement"))
+	bool bDrawViewers=false;
+
+	// 预测调度：根据对象和扫描器的速度上限，跳过短时间内不可能进入范围的子树
+	UPROPERTY(EditAnywhere)
+	bool bKineticScheduling=false;
+
+	// 扫描器的最大速度；单帧位移超过该速度时视为跳变，所有截止时间失效
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0", EditCondition="bKineticScheduling"))
+	float scannerMaxSpeed=600;
+
+	// 对象速度上限的放大系数，覆盖物理碰撞带来的加速
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", EditCondition="bKineticScheduling"))
+	float kineticSpeedMargin=1.5;
+
+	// 每帧结束时发布快照，供 AI/音频等工作线程查询
+	UPROPERTY(EditAnywhere)
+	bool bPublishSnapshot=true;
+
+	// 保存关卡时烘焙预先放置的电池的索引，开始时直接恢复而不是逐个插入（仅固定区域模式）
+	UPROPERTY(EditAnywhere)
+	bool bBakeIndex=true;
+
+	// 烘焙索引：bakedNodes 由 Serialize 整块读写，bakedObjs 作为属性保存以便引用修正
+	UPROPERTY()
+	TArray<ABattery*> bakedObjs;
+	TArray<FQuadTreeBakedNode> bakedNodes;
+	uint32 bakedConfigHash = 0;
+
+	// 对象表，下标即对象句柄；已移除对象的位置为 nullptr，句柄放入 freeHandles 复用
 	UPROPERTY()
 	TArray<ABattery*> objs;
+	TArray<uint32> freeHandles;
+
+	// 多生产者单消费者队列：工作线程写入，游戏线程在同步点读出
+	TQueue<TWeakObjectPtr<ABattery>, EQueueMode::Mpsc> pendingInserts;
+
+	// 所在单元未挂接（或离开固定区域）的对象，每帧重试
+	UPROPERTY()
+	TArray<ABattery*> orphans;
+
+	TSharedPtr<QuadTreeNode> root;	// 固定区域模式的根节点
+	TMap<FIntPoint, FQuadTreeCell> cells;	// 流式单元模式：已挂接的单元
+	TMap<ULevel*, FQuadTreeLevelEntry> levelEntries;	// 流式单元模式：每个关卡拥有的单元与对象
+	TSet<FIntPoint> tracedCells;	// 上一帧与扫描范围相交的单元
+	FDelegateHandle levelAddedHandle;
+	FDelegateHandle levelRemovedHandle;
+	FQuadTreeTuneState tuneState;
+
+	// 双缓冲：一份已发布供读取，另一份用于构建下一帧
+	TSharedPtr<FQuadTreeSnapshot, ESPMode::ThreadSafe> snapshotBuffers[2];
+	int32 snapshotBackIndex = 0;
+	FQuadTreeSnapshotPtr publishedSnapshot;
+	mutable FCriticalSection snapshotLock; // 只保护 publishedSnapshot 指针的交换
 
-	TSharedPtr<QuadTreeNode> root;
 	FTimerHandle timer;
 	FTimerHandle timer2;
+
+	TArray<FQuadTreeViewerRelevancy> viewerRelevancy;
+
+	// 预测调度状态：当前速度计划下对象的最大速度，以及用于判断扫描器跳变的上一帧状态
+	float objMaxSpeed = 50;
+	uint32 kineticEpoch = 1;
+	FVector lastScannerLocation = FVector::ZeroVector;
+	float lastScannerRadius = -1;
+	double lastKineticTime = 0;
+
+	// 生成本帧的预测调度参数，检测到跳变或速度计划变化时使旧的截止时间失效
+	FQuadTreeKineticParams MakeKineticParams();
+
+	// 场景模式：BeginPlay 生成的全部位置、下一个待生成的下标、已改变速度的次数
+	TArray<FTransform> scenarioTransforms;
+	int32 scenarioSpawnIndex = 0;
+	int32 velocityEpoch = 0;
+
+	/*
+	 * 进入/离开扫描范围事件：只在对象状态切换时触发，每帧最多各广播一次，参数为本帧切换的全部对象
+	 */
+	DECLARE_EVENT_OneParam(AQuadTree, FQuadTreeRangeEvent, const TArray<ABattery*>&);
+
+	FQuadTreeRangeEvent& OnEnterRange() { return enterRangeEvent; }
+	FQuadTreeRangeEvent& OnExitRange() { return exitRangeEvent; }
+
+	// 当前在范围内的对象，按指针排序，便于与本帧结果归并比较
+	UPROPERTY()
+	TArray<ABattery*> activeObjs;
+
+private:
+	FQuadTreeRangeEvent enterRangeEvent;
+	FQuadTreeRangeEvent exitRangeEvent;
+
+	TArray<ABattery*> inRangeObjs;	// 本帧范围检测结果
+	TArray<ABattery*> enteredObjs;
+	TArray<ABattery*> exitedObjs;
 };
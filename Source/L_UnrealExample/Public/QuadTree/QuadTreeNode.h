@@ -5,6 +5,70 @@
 #include "CoreMinimal.h"
 #include "Battery.h"
 #include "UObject/Object.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// 四叉树索引的内存归到单独的 LLM 标签下
+LLM_DECLARE_TAG_API(QuadTree, L_UNREALEXAMPLE_API);
+
+struct FConvexVolume;
+
+// 四叉树统计信息，用于自动调优叶子容量和深度
+struct FQuadTreeStats
+{
+	int32 nodeCount = 0;
+	int32 leafCount = 0;
+	int32 objCount = 0;
+	int32 depth = 0;          // 实际达到的最大深度
+	uint64 visitCount = 0;    // 范围检测访问的节点数
+	uint64 reinsertCount = 0; // 移出叶子后重新插入的次数
+};
+
+// 预测调度参数：对象与扫描器的相对速度上限，用于估计节点最早可能进入范围的时间
+struct FQuadTreeKineticParams
+{
+	double now = 0;            // 当前时间（秒）
+	float closingSpeed = 0;    // 对象最大速度 + 扫描器最大速度
+	uint32 epoch = 0;          // 速度计划变化、扫描器跳变时递增，使所有节点的截止时间失效
+};
+
+// 索引内存统计（字节），不含分配器开销，是实际占用的下限
+struct FQuadTreeMemoryStats
+{
+	SIZE_T nodeBytes = 0;     // 节点本身、引用计数控制块及子节点数组
+	SIZE_T objListBytes = 0;  // 叶子中的对象列表与坐标数组（已分配部分）
+	SIZE_T slackBytes = 0;    // 上述数组中已分配但未使用的部分
+	SIZE_T tableBytes = 0;    // AQuadTree 的对象表、孤儿列表、单元表
+	SIZE_T snapshotBytes = 0; // 快照双缓冲
+	int32 nodeCount = 0;
+
+	SIZE_T GetTotal() const { return nodeBytes + objListBytes + tableBytes + snapshotBytes; }
+};
+
+// 烘焙进关卡的扁平节点：先序存放，子节点下标总是大于父节点；对象按叶子连续存放在 AQuadTree::bakedObjs
+struct FQuadTreeBakedNode
+{
+	FVector3f center;
+	FVector3f extend;
+	int32 child[4];   // 子节点下标，INDEX_NONE 表示没有
+	int32 firstObj;
+	int32 objCount;
+	int32 depth;
+	int32 isLeaf;
+
+	friend FArchive& operator<<(FArchive& Ar, FQuadTreeBakedNode& node)
+	{
+		Ar << node.center << node.extend;
+		for (int32& c : node.child)
+		{
+			Ar << c;
+		}
+		Ar << node.firstObj << node.objCount << node.depth << node.isLeaf;
+		return Ar;
+	}
+};
+
+// 纯数据结构，允许 BulkSerialize 整块读写
+template<> struct TCanBulkSerialize<FQuadTreeBakedNode> { enum { Value = true }; };
 
 /**
  * 
@@ -16,17 +80,32 @@ public:
 	FVector extend; // 扩展尺寸
 	bool isLeaf;    //是否是叶子节点
 	int32 depth = 0;
-	int32 maxCount = 4;
+	int32 maxCount = 4;  // 叶子容量
+	int32 maxDepth = 8;  // 最大深度，达到后不再细分
+
+	uint32 visitCount = 0;    // 统计：被范围检测访问的次数
+	uint32 reinsertCount = 0; // 统计：对象移出后重新插入的次数
 
 	TArray<ABattery*>objs; 
+	// 叶子中对象的平面坐标，与 objs 一一对应（SoA），供 QuadTreeSimd 批量检测；UpdateState 每帧刷新
+	TArray<float> posX;
+	TArray<float> posY;
 	static UObject* worldObject;
 	bool bInRange;
+
+	// 预测调度：在 kineticEpoch 内、kineticDeadline 之前，子树中任何对象都不可能进入扫描范围
+	double kineticDeadline = 0;
+	uint32 kineticEpoch = 0;
+
+	int32 significance = INDEX_NONE;	// 重要度分档
+	bool bSignificanceDirty = true;		// 子树中有新插入的对象，需要重新下发分档
 	
-	TSharedPtr<QuadTreeNode> root;
+	// 不持有所有权：根节点经由 child_node 拥有整棵子树，反向强引用会形成环导致整棵树无法释放
+	QuadTreeNode* root = nullptr;
 	TArray<TSharedPtr<QuadTreeNode>> child_node;
 	
 public:
-	QuadTreeNode(FVector _center, FVector _extend, int32 _depth, TSharedPtr<QuadTreeNode> _root=nullptr);
+	QuadTreeNode(FVector _center, FVector _extend, int32 _depth, QuadTreeNode* _root=nullptr);
 
 	~QuadTreeNode();
 
@@ -51,9 +130,51 @@ public:
 	void DrawBound(float time = 0.02f, float thickness = 2.0f);
 
 	// 判断电池是否在扫描器的范围类
-	void TraceObjectInRange(AActor* traceActor, float _radian);	
+	// kinetic 不为空时，跳过截止时间未到的子树，并为不相交的节点计算新的截止时间
+	void TraceObjectInRange(FVector _OCenter, float _radian, TArray<ABattery*>& outInRange, const FQuadTreeKineticParams* kinetic = nullptr);	
 
 	void TraceObjectOutRange(FVector _OCenter, float _radian);
-	// 更新状态
-	void UpdateState();	
+	// 更新状态；离开整棵树范围的对象放入 outEscaped，由调用方重新分配
+	void UpdateState(TArray<ABattery*>& outEscaped);	
+
+	// 从子树中移除对象（遍历整棵子树，用于对象所在位置未知的情况）
+	int32 RemoveObj(ABattery* obj);
+
+	// 沿位置所在的路径找到叶子并移除；对象在上次 UpdateState 后移动过、不在该叶子时退回 RemoveObj
+	int32 RemoveObjAt(ABattery* obj, const FVector& location);
+
+	// 按节点到最近扫描器的距离确定分档；叶子分档变化或有新对象时，对分档不同的对象调用 applyBucket
+	void UpdateSignificance(const TArray<FVector>& sources, const TArray<float>& bucketDistances, TFunctionRef<void(ABattery*, int32)> applyBucket);
+
+	// 收集子树中的所有对象
+	void CollectObjs(TArray<ABattery*>& outObjs) const;
+
+	// 多观察者共享一次遍历：viewerMask 的第 v 位表示第 v 个圆仍可能与本节点相交，结果写入 outPerViewer[v]
+	void QueryViewers(TArrayView<const FVector2f> centers, TArrayView<const float> radii, uint64 viewerMask, TArrayView<TArray<ABattery*>> outPerViewer) const;
+
+	// 矩形查询，使用上次 UpdateState 时的坐标
+	void QueryBox(const FVector2f& _pMin, const FVector2f& _pMax, TArray<ABattery*>& outObjs) const;
+
+	// 视锥查询：节点包围盒（Z 方向取 ±halfHeight）与视锥各平面求交，完全在内的子树整棵接受
+	void QueryFrustum(const FConvexVolume& frustum, float halfHeight, float objRadius, TArray<ABattery*>& outObjs) const;
+
+	// 汇总统计信息，bReset 为 true 时清零计数
+	void CollectStats(FQuadTreeStats& stats, bool bReset);
+
+	// 汇总子树占用的内存
+	void CollectMemory(FQuadTreeMemoryStats& stats) const;
+
+	// 从叶子中移除第 i 个对象，objs 与坐标数组同步交换删除
+	void RemoveAtSwap(int32 i)
+	{
+		objs.RemoveAtSwap(i, 1, false);
+		posX.RemoveAtSwap(i, 1, false);
+		posY.RemoveAtSwap(i, 1, false);
+	}
+
+	// 把子树展开为扁平数组，返回本节点的下标
+	int32 Flatten(TArray<FQuadTreeBakedNode>& outNodes, TArray<ABattery*>& outObjs) const;
+
+	// 由扁平数组直接重建子树，不经过 InsertObj；调用前需已通过校验。skipObjs 中置位的对象不放入叶子
+	static TSharedPtr<QuadTreeNode> Restore(const TArray<FQuadTreeBakedNode>& nodes, const TArray<ABattery*>& objs, const TBitArray<>& skipObjs, int32 _maxCount, int32 _maxDepth);
 };
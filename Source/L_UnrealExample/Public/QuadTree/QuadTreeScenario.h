@@ -0,0 +1,104 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Commandlets/Commandlet.h"
+#include "QuadTreeScenario.generated.h"
+
+// 生成位置的分布
+UENUM()
+enum class EQuadTreeSpawnDistribution : uint8
+{
+	Uniform,	// 整个区域内均匀分布
+	Clustered,	// 围绕若干随机中心的正态分布
+	Grid,		// 规则网格，格内随机抖动
+};
+
+/**
+ * 可复现的性能测试场景：同一资源、同一区域大小总是生成完全相同的位置序列与速度序列
+ * 生成位置可以由 UQuadTreeScenarioCommandlet 预先烘焙进资源
+ */
+UCLASS(BlueprintType)
+class L_UNREALEXAMPLE_API UQuadTreeScenario : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	// 生成全部位置：已烘焙且参数未变时直接返回烘焙结果
+	void GetSpawnTransforms(const FVector2D& halfExtent, TArray<FTransform>& outTransforms) const;
+	void GenerateSpawnTransforms(const FVector2D& halfExtent, TArray<FTransform>& outTransforms) const;
+	void Bake(const FVector2D& halfExtent);
+	bool IsBakeValid(const FVector2D& halfExtent) const;
+
+	// 第 epoch 次改变速度时，句柄为 handle 的对象的速度；与遍历顺序无关
+	FVector GetVelocity(uint32 handle, int32 epoch) const;
+
+	// 影响生成结果的所有参数的哈希，用于判断烘焙结果是否过期
+	uint32 GetSettingsHash(const FVector2D& halfExtent) const;
+
+public:
+	UPROPERTY(EditAnywhere, Category="Scenario")
+	int32 seed=12345;
+
+	UPROPERTY(EditAnywhere, Category="Spawn", meta=(ClampMin="1"))
+	int32 spawnCount=20;
+
+	UPROPERTY(EditAnywhere, Category="Spawn")
+	EQuadTreeSpawnDistribution distribution=EQuadTreeSpawnDistribution::Uniform;
+
+	UPROPERTY(EditAnywhere, Category="Spawn", meta=(ClampMin="1", EditCondition="distribution==EQuadTreeSpawnDistribution::Clustered"))
+	int32 clusterCount=4;
+
+	// 正态分布的标准差
+	UPROPERTY(EditAnywhere, Category="Spawn", meta=(ClampMin="1", EditCondition="distribution==EQuadTreeSpawnDistribution::Clustered"))
+	float clusterRadius=80;
+
+	// 与区域边界保持的距离
+	UPROPERTY(EditAnywhere, Category="Spawn")
+	float edgeMargin=10;
+
+	UPROPERTY(EditAnywhere, Category="Spawn")
+	float spawnHeight=11;
+
+	// 生成速率：每隔 spawnInterval 秒生成 spawnPerTick 个，spawnInterval<=0 时在 BeginPlay 一次生成全部
+	UPROPERTY(EditAnywhere, Category="Spawn")
+	float spawnInterval=0.05;
+
+	UPROPERTY(EditAnywhere, Category="Spawn", meta=(ClampMin="1"))
+	int32 spawnPerTick=1;
+
+	// 速度计划：每隔 velocityInterval 秒给所有对象一个新方向
+	UPROPERTY(EditAnywhere, Category="Velocity", meta=(ClampMin="0.01"))
+	float velocityInterval=2;
+
+	// 第 N 次改变速度时使用 speedSchedule[N % Num]，为空时使用 speed
+	UPROPERTY(EditAnywhere, Category="Velocity")
+	float speed=50;
+
+	UPROPERTY(EditAnywhere, Category="Velocity")
+	TArray<float> speedSchedule;
+
+	// 烘焙结果，由 UQuadTreeScenarioCommandlet 写入
+	UPROPERTY(VisibleAnywhere, Category="Baked")
+	TArray<FTransform> bakedTransforms;
+
+	UPROPERTY(VisibleAnywhere, Category="Baked")
+	uint32 bakedHash=0;
+};
+
+/**
+ * 批量烘焙场景的生成位置：
+ * UnrealEditor-Cmd.exe <project> -run=QuadTreeScenario -Scenario=/Game/Path/Asset [-Width=500] [-Height=500]
+ */
+UCLASS()
+class L_UNREALEXAMPLE_API UQuadTreeScenarioCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UQuadTreeScenarioCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,97 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/VectorRegister.h"
+
+/**
+ * 叶子内的批量包含检测：坐标按 SoA 连续存放（xs/ys），每次处理 4 个对象，结果写入位掩码
+ * outMask 需要 (count + 31) / 32 个字，第 i 个对象命中时 outMask[i / 32] 的第 i % 32 位为 1
+ */
+namespace QuadTreeSimd
+{
+	inline int32 MaskWords(int32 count)
+	{
+		return (count + 31) / 32;
+	}
+
+	// 圆形：在平方距离空间比较，不开方；返回命中数
+	inline int32 TestCircle(const float* xs, const float* ys, int32 count, float cx, float cy, float radius, uint32* outMask)
+	{
+		FMemory::Memzero(outMask, MaskWords(count) * sizeof(uint32));
+		const float radiusSq = radius * radius;
+		const VectorRegister4Float vcx = VectorSetFloat1(cx);
+		const VectorRegister4Float vcy = VectorSetFloat1(cy);
+		const VectorRegister4Float vr2 = VectorSetFloat1(radiusSq);
+		int32 hits = 0;
+		int32 i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const VectorRegister4Float dx = VectorSubtract(VectorLoad(xs + i), vcx);
+			const VectorRegister4Float dy = VectorSubtract(VectorLoad(ys + i), vcy);
+			const VectorRegister4Float d2 = VectorMultiplyAdd(dx, dx, VectorMultiply(dy, dy));
+			const uint32 bits = (uint32)VectorMaskBits(VectorCompareLE(d2, vr2));
+			outMask[i >> 5] |= bits << (i & 31);	// i 是 4 的倍数，4 位不会跨字
+			hits += FMath::CountBits(bits);
+		}
+		for (; i < count; i++)
+		{
+			const float dx = xs[i] - cx;
+			const float dy = ys[i] - cy;
+			if (dx * dx + dy * dy <= radiusSq)
+			{
+				outMask[i >> 5] |= 1u << (i & 31);
+				hits++;
+			}
+		}
+		return hits;
+	}
+
+	// 矩形（含边界）；返回命中数
+	inline int32 TestBox(const float* xs, const float* ys, int32 count, const FVector2f& pMin, const FVector2f& pMax, uint32* outMask)
+	{
+		FMemory::Memzero(outMask, MaskWords(count) * sizeof(uint32));
+		const VectorRegister4Float vMinX = VectorSetFloat1(pMin.X);
+		const VectorRegister4Float vMinY = VectorSetFloat1(pMin.Y);
+		const VectorRegister4Float vMaxX = VectorSetFloat1(pMax.X);
+		const VectorRegister4Float vMaxY = VectorSetFloat1(pMax.Y);
+		int32 hits = 0;
+		int32 i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const VectorRegister4Float x = VectorLoad(xs + i);
+			const VectorRegister4Float y = VectorLoad(ys + i);
+			const VectorRegister4Float inX = VectorBitwiseAnd(VectorCompareGE(x, vMinX), VectorCompareLE(x, vMaxX));
+			const VectorRegister4Float inY = VectorBitwiseAnd(VectorCompareGE(y, vMinY), VectorCompareLE(y, vMaxY));
+			const uint32 bits = (uint32)VectorMaskBits(VectorBitwiseAnd(inX, inY));
+			outMask[i >> 5] |= bits << (i & 31);
+			hits += FMath::CountBits(bits);
+		}
+		for (; i < count; i++)
+		{
+			if (xs[i] >= pMin.X && xs[i] <= pMax.X && ys[i] >= pMin.Y && ys[i] <= pMax.Y)
+			{
+				outMask[i >> 5] |= 1u << (i & 31);
+				hits++;
+			}
+		}
+		return hits;
+	}
+
+	// 按位掩码依次回调命中对象的下标
+	template<typename FuncType>
+	inline void ForEachHit(const uint32* mask, int32 count, FuncType&& func)
+	{
+		for (int32 w = 0; w < MaskWords(count); w++)
+		{
+			uint32 bits = mask[w];
+			while (bits)
+			{
+				const int32 bit = FMath::CountTrailingZeros(bits);
+				func(w * 32 + bit);
+				bits &= bits - 1;
+			}
+		}
+	}
+}
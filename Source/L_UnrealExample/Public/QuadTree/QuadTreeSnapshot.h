@@ -0,0 +1,76 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABattery;
+class QuadTreeNode;
+
+// 快照中的扁平节点（24 字节），只保存平面包围盒；同一父节点的子节点在数组中连续存放
+struct FQuadTreeSnapshotNode
+{
+	FVector2f center;
+	FVector2f extend;
+	uint32 first = 0;       // 内部节点：第一个子节点的下标；叶子：第一个对象在 packedObjs 中的下标
+	uint32 count : 31;      // 子节点数或对象数
+	uint32 isLeaf : 1;
+};
+
+// 叶子中的紧凑对象（8 字节）：坐标相对叶子包围盒量化为 16 位，对象用 32 位句柄表示
+struct FQuadTreePackedObj
+{
+	uint16 x;
+	uint16 y;
+	uint32 handle; // AQuadTree::ResolveHandle 可在游戏线程取回对象
+};
+
+/**
+ * 四叉树的只读快照：游戏线程在每次 UpdateState 之后构建并发布，发布后不再修改，
+ * 任意线程持有引用即可无锁查询
+ */
+class L_UNREALEXAMPLE_API FQuadTreeSnapshot
+{
+public:
+	TArray<FQuadTreeSnapshotNode> nodes;
+	TArray<FQuadTreePackedObj> packedObjs; // 按叶子连续存放
+	uint64 frameNumber = 0;
+	int32 rootCount = 0;             // nodes 的前 rootCount 个是各子树的根节点
+	float cellSize = 0;              // >0 时为流式单元模式，查询经由 cellRoots 路由
+	TMap<FIntPoint, int32> cellRoots; // 单元坐标 -> 根节点下标
+
+	// 从实时四叉树构建（仅游戏线程），复用上一次的数组内存
+	// roots 为各子树的根节点及其单元坐标，固定区域模式只有一个根节点
+	void Build(const TArray<TPair<FIntPoint, const QuadTreeNode*>>& roots, float _cellSize, uint64 _frameNumber);
+
+	// 圆形查询，返回对象句柄；outPositions 不为空时同时返回解量化后的位置
+	void QueryCircle(FVector _OCenter, float _radian, TArray<uint32>& outHandles, TArray<FVector2f>* outPositions = nullptr) const;
+
+	// 矩形查询，返回对象句柄
+	void QueryBox(FVector _pMin, FVector _pMax, TArray<uint32>& outHandles, TArray<FVector2f>* outPositions = nullptr) const;
+
+	// 解量化叶子中对象的位置
+	static FVector2f Dequantize(const FQuadTreeSnapshotNode& leaf, const FQuadTreePackedObj& obj)
+	{
+		return FVector2f(
+			leaf.center.X - leaf.extend.X + obj.x * (2.0f * leaf.extend.X / MAX_uint16),
+			leaf.center.Y - leaf.extend.Y + obj.y * (2.0f * leaf.extend.Y / MAX_uint16));
+	}
+
+	// 快照占用的内存（字节）
+	SIZE_T GetAllocatedSize() const
+	{
+		return nodes.GetAllocatedSize() + packedObjs.GetAllocatedSize() + cellRoots.GetAllocatedSize();
+	}
+
+private:
+	typedef TArray<int32, TInlineAllocator<64>> FNodeStack;
+
+	// 把与查询范围相交的子树根节点压栈
+	void GatherRoots(const FVector& _pMin, const FVector& _pMax, FNodeStack& stack) const;
+
+	// 构建时使用的广度优先队列，与 nodes 下标一一对应
+	TArray<const QuadTreeNode*> buildQueue;
+};
+
+typedef TSharedPtr<const FQuadTreeSnapshot, ESPMode::ThreadSafe> FQuadTreeSnapshotPtr;
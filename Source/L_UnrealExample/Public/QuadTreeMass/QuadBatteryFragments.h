@@ -0,0 +1,62 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "MassEntityTraitBase.h"
+#include "QuadBatteryFragments.generated.h"
+
+/*
+ * AQuadTree + ABattery 示例的 Mass 版本
+ * 位置使用 MassCommon 的 FTransformFragment（Mass 表现层据此更新实例化网格），其余状态用下面的 Fragment
+ */
+
+// 平面速度
+USTRUCT()
+struct L_UNREALEXAMPLE_API FQuadBatteryVelocityFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	FVector2f value = FVector2f::ZeroVector;
+};
+
+// 是否在扫描器范围内
+USTRUCT()
+struct L_UNREALEXAMPLE_API FQuadBatteryActiveFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	bool bActive = false;
+};
+
+// 生成序号：与 AQuadTree 在同一场景下给对应对象分配的句柄相同，场景的速度计划据此取值
+USTRUCT()
+struct L_UNREALEXAMPLE_API FQuadBatteryIdFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	uint32 value = 0;
+};
+
+// 空间索引：实体在线性四叉树（固定深度、Morton 编码）中的单元
+USTRUCT()
+struct L_UNREALEXAMPLE_API FQuadBatteryCellFragment : public FMassFragment
+{
+	GENERATED_BODY()
+
+	uint32 cell = 0;
+};
+
+/**
+ * 电池实体的 Trait。实体配置资产中再加上 LOD Collector 和 Visualization Trait（网格与 BP_Battery 相同），
+ * 即可通过 Mass 表现层实例化渲染；AQuadTreeMassSpawner 未指定配置时会在代码中组装同样的配置
+ */
+UCLASS(meta = (DisplayName = "Quad Battery"))
+class L_UNREALEXAMPLE_API UQuadBatteryTrait : public UMassEntityTraitBase
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
@@ -0,0 +1,90 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTypes.h"
+#include "MassExternalSubsystemTraits.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "QuadBatteryMassSubsystem.generated.h"
+
+class UQuadTreeScenario;
+
+/**
+ * Mass 版本的场景配置与空间索引
+ * 索引是固定深度的线性四叉树：每个叶子单元用 Morton 编码，实体按编码做计数排序后连续存放，
+ * 相邻单元在内存中也相邻
+ */
+UCLASS()
+class L_UNREALEXAMPLE_API UQuadBatteryMassSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// 由 AQuadTreeMassSpawner 在 BeginPlay 调用，之后处理器才开始工作
+	void Configure(const FVector2f& _boundsMin, const FVector2f& _boundsMax, int32 _indexDepth);
+	void Reset();
+	bool IsConfigured() const { return bConfigured; }
+
+	// 位置所在单元的坐标/编码
+	FIntPoint GetCellCoord(const FVector2f& p) const;
+	uint32 GetCellCode(const FVector2f& p) const;
+
+	// 索引构建：处理器按块顺序逐个添加，最后统一排序
+	void BeginIndex();
+	void AddToIndex(uint32 cell, FMassEntityHandle handle, const FVector2f& position);
+	void FinishIndex();
+
+	// 圆形查询，返回范围内的实体
+	void QueryCircle(const FVector2f& center, float radius, TArray<FMassEntityHandle>& outEntities) const;
+
+	int32 GetIndexedCount() const { return sortedHandles.Num(); }
+
+public:
+	FVector2f boundsMin = FVector2f::ZeroVector;
+	FVector2f boundsMax = FVector2f::ZeroVector;
+
+	// 扫描器，由生成器每帧在游戏线程更新（TG_PostPhysics，此时处理器已执行完毕）
+	bool bHasScanner = false;
+	FVector2f scannerLocation = FVector2f::ZeroVector;
+	float scannerRadius = 50;
+	float scannerHeight = 11;
+
+	// 速度计划：每隔 velocityInterval 秒给所有实体一个新方向
+	float speed = 50;
+	float velocityInterval = 2;
+	int32 velocityEpoch = 0;
+
+	// 设置后速度取自场景（与 AQuadTree 的场景模式相同），speed 不再使用；由生成器持有引用
+	const UQuadTreeScenario* scenario = nullptr;
+
+	bool bDrawActive = true;
+
+	// 当前在范围内的实体，按句柄排序
+	TArray<FMassEntityHandle> activeEntities;
+
+private:
+	bool bConfigured = false;
+	int32 indexDepth = 7;
+	int32 cellsPerSide = 128;
+	FVector2f cellSize = FVector2f::UnitVector;
+
+	TArray<uint32> entryCells;
+	TArray<FMassEntityHandle> entryHandles;
+	TArray<FVector2f> entryPositions;
+
+	TArray<int32> cellStart; // 单元 i 的实体位于 [cellStart[i], cellStart[i+1])
+	TArray<FMassEntityHandle> sortedHandles;
+	TArray<FVector2f> sortedPositions;
+};
+
+// 处理器通过 ProcessorRequirements 声明对子系统的读写，可在工作线程访问，但写操作不是线程安全的
+template<>
+struct TMassExternalSubsystemTraits<UQuadBatteryMassSubsystem>
+{
+	enum
+	{
+		GameThreadOnly = false,
+		ThreadSafeWrite = false,
+	};
+};
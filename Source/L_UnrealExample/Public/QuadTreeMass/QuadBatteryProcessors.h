@@ -0,0 +1,59 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassProcessor.h"
+#include "MassEntityQuery.h"
+#include "QuadBatteryProcessors.generated.h"
+
+// 移动：按速度积分位置，碰到边界反弹；到达速度计划的时间点时换一个随机方向
+UCLASS()
+class L_UNREALEXAMPLE_API UQuadBatteryMovementProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UQuadBatteryMovementProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+	FMassEntityQuery entityQuery;
+	int32 appliedVelocityEpoch = INDEX_NONE;
+};
+
+// 空间索引：按块顺序更新每个实体的单元编码，并重建线性四叉树
+UCLASS()
+class L_UNREALEXAMPLE_API UQuadBatteryIndexProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UQuadBatteryIndexProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+	FMassEntityQuery entityQuery;
+};
+
+// 扫描器：通过索引找出范围内的实体，与上一帧比较，只改写状态切换的实体
+UCLASS()
+class L_UNREALEXAMPLE_API UQuadBatteryScannerProcessor : public UMassProcessor
+{
+	GENERATED_BODY()
+
+public:
+	UQuadBatteryScannerProcessor();
+
+protected:
+	virtual void ConfigureQueries() override;
+	virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+	// 只用于声明对 FQuadBatteryActiveFragment 的写访问，实体由索引随机访问
+	FMassEntityQuery entityQuery;
+	TArray<FMassEntityHandle> inRange;
+};
@@ -0,0 +1,93 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "MassEntityTypes.h"
+#include "QuadTreeMassSpawner.generated.h"
+
+class UMassEntityConfigAsset;
+class UQuadTreeScenario;
+class UStaticMesh;
+
+/**
+ * AQuadTree 的 Mass 版本：电池不再是 Actor，而是 Mass 实体
+ * 移动、索引、扫描都由 QuadBatteryProcessors 中的处理器完成，这里只负责生成实体和驱动扫描器
+ */
+UCLASS()
+class L_UNREALEXAMPLE_API AQuadTreeMassSpawner : public AActor
+{
+	GENERATED_BODY()
+	
+public:	
+	AQuadTreeMassSpawner();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:	
+	virtual void Tick(float DeltaTime) override;
+
+public:
+	// 需要包含 UQuadBatteryTrait，以及用于显示的 Visualization / LOD Collector 特性
+	// 留空时在代码中创建包含这三个特性的配置，用 batteryMesh 实例化渲染
+	UPROPERTY(EditAnywhere)
+	UMassEntityConfigAsset* entityConfig;
+
+	// 默认配置使用的网格，留空则用引擎自带的圆柱体
+	UPROPERTY(EditAnywhere)
+	UStaticMesh* batteryMesh;
+
+	// 与 AQuadTree 相同的可复现场景；设置后数量、位置、生成速率与速度计划都由场景决定，
+	// entityCount/speed/velocityInterval 不再使用，两个版本可以在同一场景下对比
+	UPROPERTY(EditAnywhere)
+	UQuadTreeScenario* scenario;
+
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1"))
+	int32 entityCount=100000;
+	
+	UPROPERTY(EditAnywhere)
+	int32 width=500;
+
+	UPROPERTY(EditAnywhere)
+	int32 height=500;
+
+	UPROPERTY(EditAnywhere)
+	AActor* traceActor;
+
+	UPROPERTY(EditAnywhere)
+	float affectRadianRange=50;
+
+	UPROPERTY(EditAnywhere)
+	float speed=50;
+
+	// 每隔多少秒给所有实体换一个随机方向
+	UPROPERTY(EditAnywhere, meta=(ClampMin="0.01"))
+	float velocityInterval=2;
+
+	// 线性四叉树深度，每边 2^indexDepth 个单元；单元起始表有 4^indexDepth 项，深度 10 约 4MB
+	UPROPERTY(EditAnywhere, meta=(ClampMin="1", ClampMax="10"))
+	int32 indexDepth=7;
+
+	UPROPERTY(EditAnywhere)
+	bool bDrawActive=true;
+
+private:
+	UMassEntityConfigAsset* CreateDefaultConfig();
+
+	// 生成 count 个实体；场景模式下依次取 scenarioTransforms，生成序号与 AQuadTree 的句柄一致
+	void SpawnBatch(int32 count);
+
+	UPROPERTY(Transient)
+	UMassEntityConfigAsset* defaultConfig;
+
+	UPROPERTY(Transient)
+	UMassEntityConfigAsset* activeConfig;
+
+	TArray<FMassEntityHandle> entities;
+	TArray<FTransform> scenarioTransforms;
+	float velocityTimer=0;
+	float spawnTimer=0;
+};